@@ -0,0 +1,438 @@
+#include "Bench.hh"
+#include "Any.hh"
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** 小类型的构造/拷贝/析构应当完全不触发堆分配 */
+BENCH_CASE(any_small_buffer)
+{
+    const size_t n = 1000000;
+    benchRun("construct+destroy int", n, [](size_t i)
+    {
+        Any a = int(i);
+        benchKeep(a);
+    });
+    benchRun("construct+destroy double", n, [](size_t i)
+    {
+        Any a = double(i);
+        benchKeep(a);
+    });
+    benchRun("construct+destroy const char*", n, [](size_t)
+    {
+        Any a = "const char*";
+        benchKeep(a);
+    });
+    Any src = 47;
+    benchRun("copy int", n, [&](size_t)
+    {
+        Any a = src;
+        benchKeep(a);
+    });
+    benchRun("copy-assign int", n, [&](size_t)
+    {
+        Any a;
+        a = src;
+        benchKeep(a);
+    });
+    Any big = std::string(64, 'x');
+    benchRun("copy std::string (heap)", n, [&](size_t)
+    {
+        Any a = big;
+        benchKeep(a);
+    });
+}
+
+/** is<T>()只比较一次类型标识, cast<T>()没有dynamic_cast */
+BENCH_CASE(any_type_check)
+{
+    const size_t n = 10000000;
+    std::vector<Any> values;
+    for (size_t i = 0; i < 64; ++i)
+    {
+        if (i % 2)
+            values.emplace_back(int(i));
+        else
+            values.emplace_back(std::string(64, 'x'));
+    }
+    size_t sum = 0;
+    benchRun("is<int>()", n, [&](size_t i)
+    {
+        sum += values[i & 63].is<int>();
+    });
+    benchRun("is<int>() + cast<int>()", n, [&](size_t i)
+    {
+        Any& a = values[i & 63];
+        if (a.is<int>())
+            sum += a.cast<int>();
+    });
+    benchRun("cast<std::string>() heap", n, [&](size_t i)
+    {
+        Any& a = values[(i & 31) * 2];
+        sum += a.cast<std::string>().size();
+    });
+    benchKeep(sum);
+}
+
+/** UniqueAny转移所有权只移动指针, 对比用shared_ptr包装不可拷贝对象的做法 */
+BENCH_CASE(unique_any_transfer)
+{
+    const size_t n = 1000000;
+    UniqueAny unique = std::make_unique<std::vector<int>>(64);
+    benchRun("UniqueAny(unique_ptr) move x2", n, [&](size_t)
+    {
+        UniqueAny tmp = std::move(unique);
+        unique = std::move(tmp);
+    });
+    Any shared = std::make_shared<std::vector<int>>(64);
+    benchRun("Any(shared_ptr) copy", n, [&](size_t)
+    {
+        Any tmp = shared;
+        benchKeep(tmp);
+    });
+    benchKeep(unique);
+}
+
+/** 每个请求创建1000个短生命周期的大对象Any, 对比默认的operator new和每请求释放一次的AnyArena */
+BENCH_CASE(any_arena)
+{
+    using Payload = std::array<char, 64>;
+    const size_t requests = 1000;
+    const size_t per_request = 1000;
+    std::vector<Any> bag;
+    bag.reserve(per_request);
+    auto request = [&]
+    {
+        for (size_t i = 0; i < per_request; ++i)
+            bag.emplace_back(Payload{});
+        bag.clear();
+    };
+    benchRun("1M large Anys, operator new", requests, [&](size_t)
+    {
+        request();
+    });
+    AnyArena arena;
+    benchRun("1M large Anys, AnyArena per request", requests, [&](size_t)
+    {
+        {
+            AnyResourceScope scope(arena);
+            request();
+        }
+        arena.release();
+    });
+}
+
+template <typename Param>
+__attribute__((noinline)) size_t layer3(Param field)
+{
+    return field.template cast<std::string>().size();
+}
+
+template <typename Param>
+__attribute__((noinline)) size_t layer2(Param field)
+{
+    return layer3<Param>(field);
+}
+
+template <typename Param>
+__attribute__((noinline)) size_t layer1(Param field)
+{
+    return layer2<Param>(field);
+}
+
+/** 只读地穿过三层调用: Any按值传递每层都要拷贝, AnyRef只拷贝两个指针 */
+BENCH_CASE(any_ref_pass)
+{
+    const size_t n = 1000000;
+    Any field = std::string(64, 'x');
+    size_t sum = 0;
+    benchRun("Any by value x3", n, [&](size_t)
+    {
+        sum += layer1<Any>(field);
+    });
+    benchRun("AnyRef x3", n, [&](size_t)
+    {
+        sum += layer1<AnyRef>(field);
+    });
+    benchKeep(sum);
+}
+
+/** 类型不匹配时, try_cast只是一次比较, cast则要经过诊断和异常 */
+BENCH_CASE(any_mismatch)
+{
+    Any a = 47;
+    size_t misses = 0;
+    benchRun("try_cast<long>() miss", 10000000, [&](size_t)
+    {
+        benchKeep(a);
+        misses += a.try_cast<long>() == nullptr;
+    });
+    benchRun("cast<long>() miss (throw)", 100000, [&](size_t)
+    {
+        BenchMuteCout mute;    /**< 默认配置下诊断信息写入std::cout */
+        try
+        {
+            a.cast<long>();
+        }
+        catch (std::bad_cast&)
+        {
+            ++misses;
+        }
+    });
+    benchKeep(misses);
+}
+
+/** 扫描1M个int: std::vector<Any>逐个判断类型, AnyColumn按段连续扫描 */
+BENCH_CASE(any_column_scan)
+{
+    const size_t n = 1000000;
+    std::vector<Any> rows;
+    AnyColumn column;
+    for (size_t i = 0; i < n; ++i)
+    {
+        rows.emplace_back(int(i));
+        column.push_back(int(i));
+    }
+    long sum = 0;
+    benchRun("std::vector<Any> scan 1M int", 10, [&](size_t)
+    {
+        for (const Any& a : rows)
+        {
+            if (const int* v = a.try_cast<int>())
+                sum += *v;
+        }
+    });
+    benchRun("AnyColumn::forEach<int> scan 1M int", 10, [&](size_t)
+    {
+        column.forEach<int>([&](int v) { sum += v; });
+    });
+    std::cout << "    sizeof(Any) = " << sizeof(Any) << ", AnyColumn bytes/elem ~ " << sizeof(int) << std::endl;
+    benchKeep(sum);
+}
+
+/** 把一个事件广播给1/8/64个订阅者: Any每个订阅者拷贝一次, SharedAny只增加引用计数 */
+BENCH_CASE(shared_any_fanout)
+{
+    const size_t n = 100000;
+    const std::string payload(256, 'x');
+    for (size_t subscribers : {1, 8, 64})
+    {
+        std::vector<Any> any_inbox(subscribers);
+        Any any_event = payload;
+        benchRun("Any fan-out to " + std::to_string(subscribers), n, [&](size_t)
+        {
+            for (Any& slot : any_inbox)
+                slot = any_event;
+        });
+        std::vector<SharedAny> shared_inbox(subscribers);
+        SharedAny shared_event = payload;
+        benchRun("SharedAny fan-out to " + std::to_string(subscribers), n, [&](size_t)
+        {
+            for (SharedAny& slot : shared_inbox)
+                slot = shared_event;
+        });
+    }
+}
+
+/** 以Any为键的哈希表, 对比此前把值转换为字符串作为键的做法 */
+BENCH_CASE(any_hash_key)
+{
+    const size_t keys = 1024;
+    const size_t n = 1000000;
+    std::unordered_map<Any, size_t> by_any;
+    std::unordered_map<std::string, size_t> by_string;
+    std::vector<Any> probes;
+    for (size_t i = 0; i < keys; ++i)
+    {
+        Any key = i % 2 ? Any{int(i)} : Any{std::to_string(i)};
+        by_any.emplace(key, i);
+        by_string.emplace((i % 2 ? "i:" : "s:") + std::to_string(i), i);
+        probes.push_back(key);
+    }
+    size_t sum = 0;
+    benchRun("unordered_map<Any> lookup", n, [&](size_t i)
+    {
+        sum += by_any.find(probes[i % keys])->second;
+    });
+    benchRun("unordered_map<std::string> lookup (stringify)", n, [&](size_t i)
+    {
+        const Any& key = probes[i % keys];
+        const int* v = key.try_cast<int>();
+        sum += by_string.find(v ? "i:" + std::to_string(*v) : "s:" + key.cast<std::string>())->second;
+    });
+    benchKeep(sum);
+}
+
+template <size_t N>
+struct VisitTag
+{
+    size_t value;
+};
+
+/** if(a.is<T0>()) ... else if(a.is<T1>()) ... 形式的类型分派, 平均比较N/2次 */
+template <size_t... I>
+size_t visitIfChain(const Any& a, std::index_sequence<I...>)
+{
+    size_t result = 0;
+    bool done = false;
+    (void)std::initializer_list<int>{(done || !a.is<VisitTag<I>>() ? 0 : (result = a.cast<VisitTag<I>>().value, done = true, 0))...};
+    return result;
+}
+
+template <size_t... I>
+size_t visitTable(const Any& a, std::index_sequence<I...>)
+{
+    return visit<VisitTag<I>...>(a, [](const auto& tag) { return tag.value; });
+}
+
+template <size_t N, size_t... I>
+void benchVisit(std::index_sequence<I...> types)
+{
+    const size_t n = 10000000;
+    std::vector<Any> values{VisitTag<I>{I}...};
+    size_t sum = 0;
+    benchRun("if-chain, " + std::to_string(N) + " types", n, [&](size_t i)
+    {
+        sum += visitIfChain(values[i % N], types);
+    });
+    benchRun("visit, " + std::to_string(N) + " types", n, [&](size_t i)
+    {
+        sum += visitTable(values[i % N], types);
+    });
+    benchKeep(sum);
+}
+
+/** 类型分派: if链与visit的哈希跳转表 */
+BENCH_CASE(any_visit)
+{
+    benchVisit<4>(std::make_index_sequence<4>{});
+    benchVisit<16>(std::make_index_sequence<16>{});
+    benchVisit<64>(std::make_index_sequence<64>{});
+}
+
+struct BenchRecord
+{
+    double values[8];
+};
+
+/** 反序列化1000条记录: read解码出Any, view直接引用缓冲区 */
+BENCH_CASE(any_registry_load)
+{
+    AnyRegistry registry;
+    registry.add<BenchRecord>(1);
+    std::string buf;
+    for (size_t i = 0; i < 1000; ++i)
+        registry.write(BenchRecord{{double(i)}}, buf);
+    double sum = 0;
+    benchRun("read 1000 records (copy)", 1000, [&](size_t)
+    {
+        for (size_t offset = 0; offset < buf.size();)
+            sum += registry.read(buf.data(), buf.size(), offset).cast<BenchRecord>().values[0];
+    });
+    benchRun("view 1000 records (in place)", 1000, [&](size_t)
+    {
+        for (size_t offset = 0; offset < buf.size();)
+            sum += registry.view(buf.data(), buf.size(), offset).cast<BenchRecord>().values[0];
+    });
+    benchKeep(sum);
+}
+
+/** 32个条目的属性表: AnyMap与std::unordered_map<std::string, Any>的构建和查找 */
+BENCH_CASE(any_map)
+{
+    const size_t entries = 32;
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < entries; ++i)
+        keys.push_back("attribute." + std::to_string(i));
+
+    benchRun("build std::unordered_map, 32 entries", 100000, [&](size_t)
+    {
+        std::unordered_map<std::string, Any> map;
+        for (size_t i = 0; i < entries; ++i)
+            map[keys[i]] = int(i);
+        benchKeep(map);
+    });
+    benchRun("build AnyMap, 32 entries", 100000, [&](size_t)
+    {
+        AnyMap map;
+        for (size_t i = 0; i < entries; ++i)
+            map[keys[i]] = int(i);
+        benchKeep(map);
+    });
+    benchRun("build AnyMap with reserve, 32 entries", 100000, [&](size_t)
+    {
+        AnyMap map;
+        map.reserve(entries);
+        for (size_t i = 0; i < entries; ++i)
+            map[keys[i]] = int(i);
+        benchKeep(map);
+    });
+
+    std::unordered_map<std::string, Any> std_map;
+    AnyMap any_map;
+    for (size_t i = 0; i < entries; ++i)
+    {
+        std_map[keys[i]] = int(i);
+        any_map[keys[i]] = int(i);
+    }
+    size_t sum = 0;
+    benchRun("lookup std::unordered_map", 10000000, [&](size_t i)
+    {
+        sum += std_map.find(keys[i % entries])->second.cast<int>();
+    });
+    benchRun("lookup AnyMap", 10000000, [&](size_t i)
+    {
+        sum += any_map.find(keys[i % entries])->cast<int>();
+    });
+    benchKeep(sum);
+}
+
+struct SmallNonTrivial
+{
+    SmallNonTrivial(double v) : value(v) {}
+    SmallNonTrivial(const SmallNonTrivial& that) noexcept : value(that.value) {}
+    double value;
+};
+
+/** 拷贝1000个Any: 可平凡拷贝的类型只复制缓冲区, 对比需要经过管理函数的同尺寸类型 */
+BENCH_CASE(any_trivial_copy)
+{
+    std::vector<Any> trivial(1000, Any{1.5});
+    std::vector<Any> non_trivial(1000, Any{SmallNonTrivial{1.5}});
+    benchRun("copy 1000 Any<double>", 10000, [&](size_t)
+    {
+        std::vector<Any> copy = trivial;
+        benchKeep(copy);
+    });
+    benchRun("copy 1000 Any<SmallNonTrivial>", 10000, [&](size_t)
+    {
+        std::vector<Any> copy = non_trivial;
+        benchKeep(copy);
+    });
+}
+
+/** 1到64个读线程读取配置快照: AtomicAny对比互斥锁保护的Any */
+BENCH_CASE(atomic_any_readers)
+{
+    const size_t reads = 200000;
+    AtomicAny atomic_config{Any{std::string(64, 'x')}};
+    std::mutex mutex;
+    Any locked_config = std::string(64, 'x');
+    for (size_t threads : {1, 2, 4, 8, 16, 32, 64})
+    {
+        benchThreads("mutex + Any, " + std::to_string(threads) + " readers", threads, reads, [&](size_t)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            benchKeep(locked_config.cast<std::string>().size());
+        });
+        benchThreads("AtomicAny, " + std::to_string(threads) + " readers", threads, reads, [&](size_t)
+        {
+            AtomicAny::Snapshot snapshot = atomic_config.read();
+            benchKeep(snapshot->cast<std::string>().size());
+        });
+    }
+}
@@ -0,0 +1,215 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** 进程内的堆分配次数, 由定义了BENCH_MAIN的编译单元替换全局operator new来累加 */
+inline std::atomic<size_t>& benchAllocCount()
+{
+    static std::atomic<size_t> count{0};
+    return count;
+}
+
+/** 阻止编译器把基准测试中的计算优化掉 */
+template <typename T>
+inline void benchKeep(T&& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * 在作用域内把std::cout的输出格式化后丢弃. 默认配置下类型不匹配的诊断信息写入std::cout,
+ * 基准测试用它测量这部分开销, 而不刷屏.
+ */
+class BenchMuteCout
+{
+public:
+    BenchMuteCout() : prev_(std::cout.rdbuf(&null_)) {}
+    ~BenchMuteCout() { std::cout.rdbuf(prev_); }
+
+private:
+    struct NullBuf : std::streambuf
+    {
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+    };
+
+    NullBuf null_;
+    std::streambuf* prev_;
+};
+
+struct BaseBench
+{
+    virtual void run() = 0;
+    virtual const std::string& name() const = 0;
+    virtual ~BaseBench() = default;
+};
+
+class Benchmark
+{
+private:
+    Benchmark() = default;
+    std::vector<BaseBench*> benches_;
+
+public:
+    static Benchmark& getInstance()
+    {
+        static Benchmark instance;
+        return instance;
+    }
+
+    /** 只运行名字中包含filter的基准测试, filter为空时运行全部 */
+    void runAll(const std::string& filter)
+    {
+        for(BaseBench* bench : benches_)
+        {
+            if(filter.empty() || bench->name().find(filter) != std::string::npos)
+                bench->run();
+        }
+    }
+
+    void registerBench(BaseBench* bench)
+    {
+        benches_.push_back(bench);
+    }
+};
+
+struct BenchCase : BaseBench
+{
+public:
+    BenchCase(std::function<void()> method, const std::string& name) : method_{method}, name_{name}
+    {
+        Benchmark::getInstance().registerBench(this);
+    }
+
+    void run() override
+    {
+        std::cout << "[" << name_ << "]" << std::endl;
+        method_();
+    }
+
+    const std::string& name() const override
+    {
+        return name_;
+    }
+
+private:
+    std::function<void()> method_;
+    std::string name_;
+};
+
+/** 与int等价, 但拷贝构造函数由用户提供, 因而不能平凡拷贝 */
+struct BenchNonTrivialInt
+{
+    BenchNonTrivialInt(int v) : value(v) {}
+    BenchNonTrivialInt(const BenchNonTrivialInt& that) : value(that.value) {}
+    int value;
+};
+
+/**
+ * \brief 运行func(i) iterations次, 打印每次调用的平均耗时和堆分配次数.
+ * \return 每次调用的平均耗时(纳秒).
+ */
+template <typename Func>
+double benchRun(const std::string& label, size_t iterations, Func&& func)
+{
+    size_t allocs = benchAllocCount().load();
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; ++i)
+        func(i);
+    auto stop = std::chrono::steady_clock::now();
+    allocs = benchAllocCount().load() - allocs;
+
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+    std::cout << "    " << std::left << std::setw(48) << label << std::right
+        << std::fixed << std::setprecision(2) << std::setw(12) << ns << " ns/op"
+        << std::setw(10) << double(allocs) / iterations << " allocs/op" << std::endl;
+    return ns;
+}
+
+/** 用fill填充1024个元素的std::vector, 再resize和reserve, 测量元素类型的拷贝和扩容时的搬移 */
+template <typename T>
+void benchVectorResize(const std::string& label, const T& fill)
+{
+    benchRun(label, 1000, [&](size_t)
+    {
+        std::vector<T> values(1024, fill);
+        values.resize(4096);
+        values.reserve(16384);
+        benchKeep(values);
+    });
+}
+
+/**
+ * \brief 在threads个线程上同时运行func(i) per_thread次, 打印总耗时平均到每次调用上的时间.
+ * \return 每次调用的平均耗时(纳秒).
+ */
+template <typename Func>
+double benchThreads(const std::string& label, size_t threads, size_t per_thread, Func&& func)
+{
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for(size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]
+        {
+            ++ready;
+            while(!go.load())
+                std::this_thread::yield();
+            for(size_t i = 0; i < per_thread; ++i)
+                func(i);
+        });
+    }
+    while(ready.load() != threads)
+        std::this_thread::yield();
+
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for(std::thread& worker : workers)
+        worker.join();
+    auto stop = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count() / (threads * per_thread);
+    std::cout << "    " << std::left << std::setw(48) << label << std::right
+        << std::fixed << std::setprecision(2) << std::setw(12) << ns << " ns/op" << std::endl;
+    return ns;
+}
+
+#ifdef BENCH_MAIN
+void* operator new(std::size_t size)
+{
+    benchAllocCount().fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char* argv[])
+{
+    Benchmark::getInstance().runAll(argc > 1 ? argv[1] : "");
+}
+#endif
+
+#define BENCH_CASE(bench_name)                                                                  \
+void bench_name();                                                                              \
+BenchCase bench_name##_bench{bench_name, #bench_name};                                          \
+void bench_name()
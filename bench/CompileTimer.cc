@@ -0,0 +1,20 @@
+/**
+ * 编译期基准测试的计时工具: 运行参数组成的命令, 以0.01秒的精度打印其耗时.
+ * cmake -E time只精确到秒, 无法区分几百毫秒的编译时间. 不参与zbase_bench的链接.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+    std::string command;
+    for (int i = 1; i < argc; ++i)
+        command += std::string{i == 1 ? "" : " "} + "'" + argv[i] + "'";
+    auto start = std::chrono::steady_clock::now();
+    int status = std::system(command.c_str());
+    auto stop = std::chrono::steady_clock::now();
+    std::printf("    %.2f s\n", std::chrono::duration<double>(stop - start).count());
+    return status == 0 ? 0 : 1;
+}
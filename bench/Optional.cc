@@ -0,0 +1,11 @@
+#include "Bench.hh"
+#include "Optional.hh"
+#include <vector>
+
+/** 可以平凡拷贝的Optional在vector扩容时整体memcpy */
+BENCH_CASE(optional_vector_resize)
+{
+    benchVectorResize("vector<Optional<int>> fill+resize+reserve", Optional<int>{1});
+    benchVectorResize("vector<Optional<NonTrivialInt>> fill+resize+reserve",
+        Optional<BenchNonTrivialInt>{BenchNonTrivialInt{1}});
+}
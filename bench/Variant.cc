@@ -0,0 +1,349 @@
+#include "Bench.hh"
+#include "Variant.hh"
+#include <string>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+
+/** 类型不匹配时, get_if只是一次比较, get则要经过诊断和异常 */
+BENCH_CASE(variant_mismatch)
+{
+    Variant<int, std::string> v = 47;
+    size_t misses = 0;
+    benchRun("get_if<std::string>() miss", 10000000, [&](size_t)
+    {
+        misses += v.get_if<std::string>() == nullptr;
+    });
+    benchRun("get<std::string>() miss (throw)", 100000, [&](size_t)
+    {
+        BenchMuteCout mute;    /**< 默认配置下诊断信息写入std::cout */
+        try
+        {
+            v.get<std::string>();
+        }
+        catch (std::bad_cast&)
+        {
+            ++misses;
+        }
+    });
+    benchKeep(misses);
+}
+
+template <size_t N>
+struct Alternative
+{
+    Alternative(size_t v) : value(v) {}
+    Alternative(const Alternative& that) : value(that.value) {}
+    size_t value;
+};
+
+/** 拷贝和销毁持有最后一个候选类型的Variant */
+template <size_t... I>
+void benchVariantCopy(std::index_sequence<I...>)
+{
+    using V = Variant<Alternative<I>...>;
+    const size_t last = sizeof...(I) - 1;
+    V v = Alternative<last>{last};
+    std::cout << "    sizeof(Variant<" << sizeof...(I) << " alternatives>) = " << sizeof(V) << std::endl;
+    benchRun("copy+destroy, " + std::to_string(sizeof...(I)) + " alternatives", 10000000, [&](size_t)
+    {
+        V copy = v;
+        benchKeep(copy);
+    });
+}
+
+/** copy/destroy的分派开销随候选类型数量的变化 */
+BENCH_CASE(variant_dispatch)
+{
+    benchVariantCopy(std::make_index_sequence<2>{});
+    benchVariantCopy(std::make_index_sequence<8>{});
+    benchVariantCopy(std::make_index_sequence<32>{});
+}
+
+template <size_t N>
+struct Event
+{
+    size_t value;
+};
+
+struct EventHandler
+{
+    template <size_t N>
+    size_t operator()(const Event<N>& event) const
+    {
+        return event.value + N;
+    }
+};
+
+template <typename V, size_t I, size_t... Rest>
+size_t handleByChain(const V& v, std::index_sequence<I, Rest...>)
+{
+    if (v.template is<Event<I>>())
+        return EventHandler{}(*v.template get_if<Event<I>>());
+    return handleByChain(v, std::index_sequence<Rest...>{});
+}
+
+template <typename V>
+size_t handleByChain(const V&, std::index_sequence<>)
+{
+    return 0;
+}
+
+/** 状态机的事件循环: 逐个is<T>()判断与visit一次间接跳转的对比 */
+template <size_t... I>
+void benchVariantVisit(std::index_sequence<I...> seq)
+{
+    using V = Variant<Event<I>...>;
+    std::vector<V> events;
+    const V samples[] = { Event<I>{I}... };
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 4096; ++i)
+    {
+        seed = seed * 1103515245 + 12345;    /**< 事件顺序随机, 分支预测无法记住 */
+        events.push_back(samples[(seed >> 16) % sizeof...(I)]);
+    }
+    size_t sum = 0;
+    benchRun("is<T>() chain, " + std::to_string(sizeof...(I)) + " events", 10000000, [&](size_t i)
+    {
+        sum += handleByChain(events[i & 4095], seq);
+    });
+    benchRun("visit, " + std::to_string(sizeof...(I)) + " events", 10000000, [&](size_t i)
+    {
+        sum += visit(EventHandler{}, events[i & 4095]);
+    });
+    benchKeep(sum);
+}
+
+BENCH_CASE(variant_visit)
+{
+    benchVariantVisit(std::make_index_sequence<4>{});
+    benchVariantVisit(std::make_index_sequence<16>{});
+    benchVariantVisit(std::make_index_sequence<64>{});
+    benchVariantVisit(std::make_index_sequence<128>{});    /**< 超过64种组合, 改用函数指针表 */
+}
+
+/** 候选类型不变的赋值复用std::string已有的容量 */
+BENCH_CASE(variant_assign)
+{
+    using V = Variant<int, std::string>;
+    const V a = std::string(64, 'a'), b = std::string(48, 'b');
+    V v = a;
+    benchRun("assign same alternative (std::string)", 1000000, [&](size_t i)
+    {
+        v = (i & 1) ? a : b;
+    });
+    const V number = 47;
+    benchRun("assign switching alternative", 1000000, [&](size_t i)
+    {
+        v = (i & 1) ? a : number;
+    });
+    benchKeep(v);
+}
+
+/** 可以平凡拷贝的Variant在vector扩容时整体memcpy */
+BENCH_CASE(variant_vector_resize)
+{
+    benchVectorResize("vector<Variant<int, float>> fill+resize+reserve", Variant<int, float>{1.0f});
+    benchVectorResize("vector<Variant<int, float, NonTrivialInt>> fill+resize+reserve",
+        Variant<int, float, BenchNonTrivialInt>{1.0f});
+}
+
+/** 一个大的候选类型使std::vector<Variant>的每个元素都按它补齐 */
+struct Matrix4
+{
+    double m[16];
+};
+
+/** 按类型分列存储与std::vector<Variant>的内存占用和扫描速度 */
+BENCH_CASE(variant_vector)
+{
+    using V = Variant<int, float, Matrix4>;
+    const size_t count = 1 << 20;
+    std::vector<V> aos;
+    VariantVector<int, float, Matrix4> soa;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i % 64 == 0)
+        {
+            aos.push_back(Matrix4{});
+            soa.push_back(Matrix4{});
+        }
+        else if (i % 2)
+        {
+            aos.push_back(int(i));
+            soa.push_back(int(i));
+        }
+        else
+        {
+            aos.push_back(float(i));
+            soa.push_back(float(i));
+        }
+    }
+    std::cout << "    std::vector<Variant>: " << soa.variantBytes() / 1024 << " KB, VariantVector: "
+        << soa.bytes() / 1024 << " KB" << std::endl;
+
+    double sum = 0;
+    auto add = overloaded(
+        [&](int v) { sum += v; },
+        [&](float v) { sum += v; },
+        [&](const Matrix4& m) { sum += m.m[0]; });
+    benchRun("std::vector<Variant> visit loop, 1M elements", 10, [&](size_t)
+    {
+        for (const V& v : aos)
+            visit(add, v);
+    });
+    benchRun("VariantVector::visit_all, 1M elements", 10, [&](size_t)
+    {
+        soa.visit_all(add);
+    });
+    benchKeep(sum);
+}
+
+struct alignas(8) TreeNode
+{
+    int64_t value;
+};
+
+/** 指针和int32_t共用一个字, 节点数组的大小减半 */
+template <typename V>
+void benchPackedScan(const std::string& label, std::vector<TreeNode>& nodes)
+{
+    std::vector<V> children;
+    for (size_t i = 0; i < (1 << 20); ++i)
+    {
+        if (i % 3)
+            children.push_back(V{&nodes[i % nodes.size()]});
+        else
+            children.push_back(V{int32_t(i)});
+    }
+    std::cout << "    sizeof(" << label << ") = " << sizeof(V) << ", array of 1M: " << children.size() * sizeof(V) / 1024 << " KB" << std::endl;
+    int64_t sum = 0;
+    auto add = overloaded(
+        [&](TreeNode* n) { sum += n->value; },
+        [&](int32_t v) { sum += v; });
+    benchRun(label + " visit, 1M elements", 20, [&](size_t)
+    {
+        for (const V& child : children)
+            visit(add, child);
+    });
+    benchKeep(sum);
+}
+
+BENCH_CASE(packed_variant)
+{
+    std::vector<TreeNode> nodes(1024, TreeNode{1});
+    benchPackedScan<Variant<TreeNode*, int32_t>>("Variant<TreeNode*, int32_t>", nodes);
+    benchPackedScan<PackedVariant<TreeNode*, int32_t>>("PackedVariant<TreeNode*, int32_t>", nodes);
+}
+
+/** 约4KB的候选类型, 构造时只填写开头; 带有std::string成员, 移动时要复制整个数组 */
+struct Page
+{
+    Page(size_t id) : id(id) { data[0] = char(id); }
+    size_t id;
+    std::string title;
+    char data[4096 - sizeof(size_t) - sizeof(std::string)];
+};
+
+/** 先构造再移动与直接在Variant内构造的对比 */
+BENCH_CASE(variant_emplace)
+{
+    using V = Variant<int, Page>;
+    V v;
+    benchRun("v = Page{i} (construct + move 4KB)", 1000000, [&](size_t i)
+    {
+        v = int(i);
+        v = Page{i};
+        benchKeep(v);
+    });
+    benchRun("v.emplace<Page>(i)", 1000000, [&](size_t i)
+    {
+        v = int(i);
+        v.emplace<Page>(i);
+        benchKeep(v);
+    });
+}
+
+/** 以前的做法: 经过is<T>()和get<T>()逐个类型比较 */
+struct VariantLessByGet
+{
+    template <typename V>
+    bool operator()(V& a, V& b) const
+    {
+        if (a.index() != b.index())
+            return a.index() < b.index();
+        if (a.template is<int>())
+            return a.template get<int>() < b.template get<int>();
+        return a.template get<std::string>() < b.template get<std::string>();
+    }
+};
+
+/** 按值排序和哈希查找 */
+BENCH_CASE(variant_compare)
+{
+    using V = Variant<int, std::string>;
+    std::vector<V> keys;
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 100000; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        if (seed & 0x10000)
+            keys.push_back(V{int(seed >> 8)});
+        else
+            keys.push_back(V{std::to_string(seed >> 8)});
+    }
+    benchRun("std::sort 100k, get<T>() comparator", 10, [&](size_t)
+    {
+        std::vector<V> sorted = keys;
+        std::sort(sorted.begin(), sorted.end(), VariantLessByGet{});
+        benchKeep(sorted);
+    });
+    benchRun("std::sort 100k, operator<", 10, [&](size_t)
+    {
+        std::vector<V> sorted = keys;
+        std::sort(sorted.begin(), sorted.end());
+        benchKeep(sorted);
+    });
+    std::unordered_set<V> set(keys.begin(), keys.end());
+    size_t hits = 0;
+    benchRun("std::unordered_set<Variant>::count", 1000000, [&](size_t i)
+    {
+        hits += set.count(keys[i % keys.size()]);
+    });
+    benchKeep(hits);
+}
+
+struct TreeBranch;
+using TreeValue = Variant<int64_t, VariantBox<TreeBranch>>;
+
+struct TreeBranch
+{
+    TreeValue left;
+    TreeValue right;
+};
+
+/** 深度为depth的完全二叉树, 2^depth - 1个内部节点 */
+TreeValue buildTree(int depth)
+{
+    if (depth == 0)
+        return TreeValue{int64_t(1)};
+    return TreeValue{VariantBox<TreeBranch>{TreeBranch{buildTree(depth - 1), buildTree(depth - 1)}}};
+}
+
+/** 构造并销毁一百万个节点的递归Variant树 */
+BENCH_CASE(variant_box_tree)
+{
+    benchRun("build+destroy 1M-node tree, operator new", 3, [&](size_t)
+    {
+        TreeValue tree = buildTree(20);
+        benchKeep(tree);
+    });
+    benchRun("build+destroy 1M-node tree, ZBaseArena", 3, [&](size_t)
+    {
+        ZBaseArena arena(1 << 20);
+        ZBaseResourceScope scope(arena);
+        TreeValue tree = buildTree(20);
+        benchKeep(tree);
+    });
+}
@@ -0,0 +1,36 @@
+/**
+ * 编译期基准测试: 实例化有ALTERNATIVES个候选类型的Variant, 由compile_bench目标分别以8/64/256编译并计时.
+ * 不参与zbase_bench的链接.
+ */
+#include "Variant.hh"
+#include <utility>
+
+#ifndef ALTERNATIVES
+#define ALTERNATIVES 8
+#endif
+
+template <size_t N>
+struct Alternative
+{
+    size_t value;
+    bool operator==(const Alternative& rhs) const { return value == rhs.value; }
+};
+
+template <size_t... I>
+size_t useVariant(std::index_sequence<I...>)
+{
+    using V = Variant<Alternative<I>...>;
+    const size_t last = sizeof...(I) - 1;
+    V v = Alternative<last>{last};
+    V copy = v;
+    size_t sum = copy.template is<Alternative<last>>() + size_t(v.template indexOf<Alternative<last / 2>>());
+    int expand[] = { (sum += v.template get_if<Alternative<I>>() != nullptr, 0)... };
+    (void)expand;
+    sum += visit([](const auto& a) { return a.value; }, v);
+    return sum + (v == copy);
+}
+
+int main()
+{
+    return int(useVariant(std::make_index_sequence<ALTERNATIVES>{}) & 1);
+}
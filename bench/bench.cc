@@ -0,0 +1,2 @@
+#define BENCH_MAIN
+#include "Bench.hh"
@@ -1,34 +1,499 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <unordered_map>
 #include <memory>
-#include <typeindex>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#include <type_traits>
 #include <exception>
+#include <typeinfo>
+#include <atomic>
+#ifndef ZBASE_DIAGNOSTIC_HOOK
 #include <iostream>
+#endif
 
+/** 编译时指定了-fno-rtti时自动进入无RTTI模式, 类型名改由__PRETTY_FUNCTION__提供 */
+#if !defined(ZBASE_NO_RTTI) && !defined(__GXX_RTTI) && !defined(_CPPRTTI)
+#define ZBASE_NO_RTTI
+#endif
+
+#ifndef ZBASE_DIAGNOSTIC_DEFINED
+#define ZBASE_DIAGNOSTIC_DEFINED
 /**
- * \brief [API] Any类，可储存任何copyable的类型.
+ * \brief [API] 诊断信息的输出钩子, what为出错的操作, expected和actual为类型名.
+ * \note 定义了ZBASE_DIAGNOSTIC_HOOK时, 类型不匹配的诊断信息不再写入std::cout, 而是交给这里设置的钩子(未设置时丢弃).
+ *       读取钩子只是一次原子load, 不会加锁.
  * \example
- *      Any a = "const char*";
- *      if(a.is<const char*>())
- *          std::cout << a.cast<const char*>() << std::endl;
+ *      zbaseDiagnosticHook().store([](const char* what, const char* expected, const char* actual)
+ *      {
+ *          lock_free_log_push(what, expected, actual);
+ *      });
+ */
+using ZBaseDiagnosticHook = void (*)(const char* what, const char* expected, const char* actual);
+
+inline std::atomic<ZBaseDiagnosticHook>& zbaseDiagnosticHook()
+{
+	static std::atomic<ZBaseDiagnosticHook> hook{nullptr};
+	return hook;
+}
+#endif
+
+/**
+ * \brief 类型信息, 每个类型对应唯一的静态对象, 该对象的地址即为类型标识.
+ * \note equal/less/hash在类型不支持==, <或std::hash时为nullptr.
+ */
+struct AnyTypeInfo
+{
+	const char* (*name)();
+	bool (*equal)(const void* lhs, const void* rhs);
+	bool (*less)(const void* lhs, const void* rhs);
+	size_t (*hash)(const void* value);
+};
+
+using AnyTypeId = const AnyTypeInfo*;
+
+#ifdef ZBASE_NO_RTTI
+/** 从__PRETTY_FUNCTION__中取出"T = "之后的类型名, 如"const char* anyTypeName() [with T = int]"中的"int" */
+inline std::string anyPrettyTypeName_(const char* pretty)
+{
+	std::string name{pretty};
+	size_t begin = name.find("T = ");
+	if (begin == std::string::npos)
+		return name;
+	begin += 4;
+	size_t end = name.find(';', begin);
+	if (end == std::string::npos)
+		end = name.rfind(']');
+	if (end == std::string::npos || end < begin)
+		end = name.size();
+	return name.substr(begin, end - begin);
+}
+#endif
+
+template<typename T>
+const char* anyTypeName()
+{
+#ifdef ZBASE_NO_RTTI
+	static const std::string name = anyPrettyTypeName_(__PRETTY_FUNCTION__);
+	return name.c_str();
+#else
+	return typeid(T).name();
+#endif
+}
+
+template<bool... Bs>
+struct AnyAll_ : std::is_same<AnyAll_<Bs...>, AnyAll_<(Bs || true)...>>
+{
+};
+
+/**
+ * 容器, pair和tuple的==与<不受约束地声明, 元素不支持时在实例化函数体时才报错,
+ * 因此还要递归检查value_type和各成员的类型.
+ */
+template<template<typename, typename> class Has, typename T, typename = void>
+struct AnyElementsHave_ : std::true_type
+{
+};
+
+template<template<typename, typename> class Has, typename T>
+struct AnyElementsHave_<Has, T, typename std::enable_if<!std::is_same<typename T::value_type, T>::value>::type>
+	: Has<typename std::remove_cv<typename T::value_type>::type, void>
+{
+};
+
+template<template<typename, typename> class Has, typename A, typename B>
+struct AnyElementsHave_<Has, std::pair<A, B>, void>
+	: AnyAll_<Has<typename std::remove_cv<A>::type, void>::value, Has<typename std::remove_cv<B>::type, void>::value>
+{
+};
+
+template<template<typename, typename> class Has, typename... Ts>
+struct AnyElementsHave_<Has, std::tuple<Ts...>, void>
+	: AnyAll_<Has<typename std::remove_cv<Ts>::type, void>::value...>
+{
+};
+
+template<typename T, typename = void>
+struct AnyHasEqual_ : std::false_type
+{
+};
+
+template<typename T>
+struct AnyHasEqual_<T, decltype(void(std::declval<const T&>() == std::declval<const T&>()))>
+	: AnyElementsHave_<AnyHasEqual_, T>
+{
+};
+
+template<typename T, typename = void>
+struct AnyHasLess_ : std::false_type
+{
+};
+
+template<typename T>
+struct AnyHasLess_<T, decltype(void(std::declval<const T&>() < std::declval<const T&>()))>
+	: AnyElementsHave_<AnyHasLess_, T>
+{
+};
+
+/** 只为支持==的类型实例化比较函数 */
+template<typename T, bool = AnyHasEqual_<T>::value>
+struct AnyEqualOp_
+{
+	static constexpr bool (*get())(const void*, const void*) { return nullptr; }
+};
+
+template<typename T>
+struct AnyEqualOp_<T, true>
+{
+	static bool equal(const void* lhs, const void* rhs)
+	{
+		return *static_cast<const T*>(lhs) == *static_cast<const T*>(rhs);
+	}
+
+	static constexpr bool (*get())(const void*, const void*) { return &equal; }
+};
+
+template<typename T, bool = AnyHasLess_<T>::value>
+struct AnyLessOp_
+{
+	static constexpr bool (*get())(const void*, const void*) { return nullptr; }
+};
+
+template<typename T>
+struct AnyLessOp_<T, true>
+{
+	static bool less(const void* lhs, const void* rhs)
+	{
+		return *static_cast<const T*>(lhs) < *static_cast<const T*>(rhs);
+	}
+
+	static constexpr bool (*get())(const void*, const void*) { return &less; }
+};
+
+template<typename T, typename = void>
+struct AnyHashOp_
+{
+	static constexpr size_t (*get())(const void*) { return nullptr; }
+};
+
+template<typename T>
+struct AnyHashOp_<T, decltype(void(std::hash<T>{}(std::declval<const T&>())))>
+{
+	static size_t hash(const void* value)
+	{
+		return std::hash<T>{}(*static_cast<const T*>(value));
+	}
+
+	static constexpr size_t (*get())(const void*) { return &hash; }
+};
+
+template<typename T>
+struct AnyTypeTag
+{
+	static const AnyTypeInfo info;
+};
+
+/** 常量初始化, 在任何动态初始化之前即可使用 */
+template<typename T>
+const AnyTypeInfo AnyTypeTag<T>::info = { &anyTypeName<T>, AnyEqualOp_<T>::get(), AnyLessOp_<T>::get(), AnyHashOp_<T>::get() };
+
+/** 与typeid一致, 忽略引用和顶层cv修饰 */
+template<typename T>
+constexpr AnyTypeId anyTypeId()
+{
+	return &AnyTypeTag<typename std::remove_cv<typename std::remove_reference<T>::type>::type>::info;
+}
+
+#ifndef ZBASE_MEMORY_RESOURCE_DEFINED
+#define ZBASE_MEMORY_RESOURCE_DEFINED
+/**
+ * \brief [API] Any的大对象和VariantBox中的对象从这里分配内存.
+ * \note 对象之前记录了其内存来源, 因此释放时总是归还给分配它的那个resource.
+ *       Any.hh和Variant.hh共用这一组类型, 同一个内存池可以同时服务两者.
+ */
+struct ZBaseMemoryResource
+{
+	virtual void* allocate(size_t size, size_t align) = 0;
+	virtual void deallocate(void* p, size_t size, size_t align) noexcept = 0;
+	virtual ~ZBaseMemoryResource() = default;
+};
+
+/** 默认的内存来源, 即operator new/delete */
+struct ZBaseNewDeleteResource : ZBaseMemoryResource
+{
+	constexpr ZBaseNewDeleteResource() {}
+
+	void* allocate(size_t size, size_t) override
+	{
+		return ::operator new(size);
+	}
+
+	void deallocate(void* p, size_t, size_t) noexcept override
+	{
+		::operator delete(p);
+	}
+
+	static ZBaseNewDeleteResource& instance()
+	{
+		static ZBaseNewDeleteResource resource;
+		return resource;
+	}
+};
+
+/**
+ * \brief [API] 单调递增的内存池, 从大块内存中顺序分配, deallocate什么也不做, release()或析构时一次性释放.
+ * \note 调用release()之前, 必须先销毁所有从该内存池分配的对象. 大块内存来自upstream, 默认为operator new.
+ * \example
+ *      ZBaseArena arena;
+ *      {
+ *          ZBaseResourceScope scope(arena);    // 本线程接下来的分配都来自arena
+ *          handle_request();
+ *      }
+ *      arena.release();
+ */
+class ZBaseArena : public ZBaseMemoryResource
+{
+public:
+	explicit ZBaseArena(size_t block_size = 64 * 1024, ZBaseMemoryResource& upstream = ZBaseNewDeleteResource::instance())
+		: blocks_(nullptr), cur_(nullptr), end_(nullptr), block_size_(block_size), upstream_(upstream) {}
+
+	ZBaseArena(const ZBaseArena&) = delete;
+	ZBaseArena& operator=(const ZBaseArena&) = delete;
+
+	~ZBaseArena()
+	{
+		release();
+	}
+
+	void* allocate(size_t size, size_t align) override
+	{
+		char* p = alignUp(cur_, align);
+		if (cur_ == nullptr || p + size > end_)
+		{
+			grow(size + align);
+			p = alignUp(cur_, align);
+		}
+		cur_ = p + size;
+		return p;
+	}
+
+	void deallocate(void*, size_t, size_t) noexcept override {}
+
+	void release() noexcept
+	{
+		while (blocks_ != nullptr)
+		{
+			Block_* next = blocks_->next;
+			upstream_.deallocate(blocks_, blocks_->size, alignof(Block_));
+			blocks_ = next;
+		}
+		cur_ = end_ = nullptr;
+	}
+
+private:
+	struct Block_
+	{
+		Block_* next;
+		size_t size;
+	};
+
+	static char* alignUp(char* p, size_t align)
+	{
+		return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~(uintptr_t)(align - 1));
+	}
+
+	/** 超过block_size_的请求单独分配一块 */
+	void grow(size_t min_size)
+	{
+		size_t size = sizeof(Block_) + (min_size > block_size_ ? min_size : block_size_);
+		Block_* block = static_cast<Block_*>(upstream_.allocate(size, alignof(Block_)));
+		block->next = blocks_;
+		block->size = size;
+		blocks_ = block;
+		cur_ = reinterpret_cast<char*>(block + 1);
+		end_ = reinterpret_cast<char*>(block) + size;
+	}
+
+	Block_* blocks_;
+	char* cur_;
+	char* end_;
+	size_t block_size_;
+	ZBaseMemoryResource& upstream_;
+};
+
+/** 当前线程的内存来源, nullptr表示ZBaseNewDeleteResource */
+inline ZBaseMemoryResource*& zbaseThreadResource()
+{
+	static thread_local ZBaseMemoryResource* resource = nullptr;
+	return resource;
+}
+
+inline ZBaseMemoryResource& zbaseCurrentResource()
+{
+	ZBaseMemoryResource* resource = zbaseThreadResource();
+	return resource != nullptr ? *resource : ZBaseNewDeleteResource::instance();
+}
+
+/** \brief [API] 在作用域内把当前线程的内存来源替换为resource, 包括拷贝时的分配. */
+class ZBaseResourceScope
+{
+public:
+	explicit ZBaseResourceScope(ZBaseMemoryResource& resource) : prev_(zbaseThreadResource())
+	{
+		zbaseThreadResource() = &resource;
+	}
+
+	ZBaseResourceScope(const ZBaseResourceScope&) = delete;
+	ZBaseResourceScope& operator=(const ZBaseResourceScope&) = delete;
+
+	~ZBaseResourceScope()
+	{
+		zbaseThreadResource() = prev_;
+	}
+
+private:
+	ZBaseMemoryResource* prev_;
+};
+#endif
+
+/** Any的内存来源, 与VariantBox共用, 见ZBaseMemoryResource */
+using AnyMemoryResource = ZBaseMemoryResource;
+using AnyNewDeleteResource = ZBaseNewDeleteResource;
+using AnyArena = ZBaseArena;
+using AnyResourceScope = ZBaseResourceScope;
+
+inline AnyMemoryResource*& anyThreadResource()
+{
+	return zbaseThreadResource();
+}
+
+inline AnyMemoryResource& anyCurrentResource()
+{
+	return zbaseCurrentResource();
+}
+
+/** 类型不匹配时输出诊断信息并抛出std::bad_cast */
+template<typename U>
+[[noreturn]] void anyBadCast(AnyTypeId actual)
+{
+#ifdef ZBASE_DIAGNOSTIC_HOOK
+	if (ZBaseDiagnosticHook hook = zbaseDiagnosticHook().load(std::memory_order_acquire))
+		hook("Any::cast", anyTypeName<U>(), actual->name());
+#else
+	std::cout << "can not cast " << anyTypeName<U>() << " to " << actual->name() << std::endl;
+#endif
+	throw std::bad_cast{};
+}
+
+class AnyRef;
+class SharedAny;
+class AtomicAny;
+
+/** \brief [API] 某个类型储存在堆上的Any的统计. */
+struct AnyHeapStat
+{
+	AnyTypeId type;
+	const char* name;
+	size_t live;            /**< 存活的对象数 */
+	size_t bytes;           /**< 占用的字节数, 包括记录内存来源的头部 */
+};
+
+/**
+ * \brief 按类型统计Any的堆分配, 只在定义了ZBASE_ANY_ACCOUNTING时启用, 否则没有任何开销.
+ * \note 每个类型一个计数器, 第一次分配时以无锁方式挂到全局链表上, 计数使用relaxed原子操作.
+ *       所有编译单元必须一致地定义或不定义ZBASE_ANY_ACCOUNTING.
  */
-struct Any
+class AnyAccounting
 {
-	Any(void) : tp_index_(std::type_index(typeid(void))) {}
+public:
+	struct Counter
+	{
+		explicit Counter(AnyTypeId t) : type(t), live(0), bytes(0), next(nullptr)
+		{
+			std::atomic<Counter*>& head = list();
+			next = head.load(std::memory_order_relaxed);
+			while (!head.compare_exchange_weak(next, this, std::memory_order_release, std::memory_order_relaxed))
+			{
+			}
+		}
 
-	Any(const Any& that) : ptr_(that.clone()), tp_index_(that.tp_index_) {}
+		AnyTypeId type;
+		std::atomic<size_t> live;
+		std::atomic<size_t> bytes;
+		Counter* next;
+	};
+
+	template<typename T>
+	static Counter& counter()
+	{
+		static Counter instance(anyTypeId<T>());
+		return instance;
+	}
+
+	template<typename T>
+	static void allocated(size_t bytes)
+	{
+		Counter& c = counter<T>();
+		c.live.fetch_add(1, std::memory_order_relaxed);
+		c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	template<typename T>
+	static void deallocated(size_t bytes)
+	{
+		Counter& c = counter<T>();
+		c.live.fetch_sub(1, std::memory_order_relaxed);
+		c.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+	}
 
-	Any(Any && that) : ptr_(std::move(that.ptr_)), tp_index_(that.tp_index_) {}
+	static std::atomic<Counter*>& list()
+	{
+		static std::atomic<Counter*> head{nullptr};
+		return head;
+	}
+};
 
-	/** 创建智能指针时，对于一般的类型，通过std::decay来移除引用和cv符，从而获取原始类型 */
-	template<typename U, class = typename std::enable_if<!std::is_same<typename std::decay<U>::type, Any>::value, U>::type> 
-    Any(U && value) : ptr_(new Derived<typename std::decay<U>::type>(std::forward<U>(value))),
-		tp_index_(std::type_index(typeid(typename std::decay<U>::type))) {}
+/**
+ * \brief [API] 当前每个类型的Any堆分配统计, 只包含曾经在堆上储存过的类型.
+ * \note 未定义ZBASE_ANY_ACCOUNTING时总是返回空.
+ */
+inline std::vector<AnyHeapStat> anyHeapSnapshot()
+{
+	std::vector<AnyHeapStat> stats;
+#ifdef ZBASE_ANY_ACCOUNTING
+	for (AnyAccounting::Counter* c = AnyAccounting::list().load(std::memory_order_acquire); c != nullptr; c = c->next)
+		stats.push_back(AnyHeapStat{c->type, c->type->name(), c->live.load(std::memory_order_relaxed), c->bytes.load(std::memory_order_relaxed)});
+#endif
+	return stats;
+}
 
-	bool isNull() const { return !bool(ptr_); }
+/**
+ * \brief Any与UniqueAny共用的存储和类型标识.
+ * \note 不超过内联缓冲区大小且移动构造不抛异常的类型直接存放在内部, 不会进行堆分配.
+ *       类型判断只比较一次类型标识的地址, 不依赖RTTI.
+ */
+class AnyBase_
+{
+public:
+	bool isNull() const { return type_ == anyTypeId<void>(); }
 
 	template<class U> bool is() const
 	{
-		return tp_index_ == std::type_index(typeid(U));
+		return type_ == anyTypeId<U>();
+	}
+
+	AnyTypeId type() const
+	{
+		return type_;
 	}
 
 	/* 将Any转换为实际的类型 */
@@ -36,57 +501,1587 @@ struct Any
 	U& cast()
 	{
 		if (!is<U>())
-		{
-			std::cout << "can not cast " << typeid(U).name() << " to " << tp_index_.name() << std::endl;
-			throw std::bad_cast{};
-		}
+			anyBadCast<U>(type_);
 
-		auto derived = dynamic_cast<Derived<U>*> (ptr_.get());
-		return derived->value;
+		return *Manager_<typename std::remove_cv<U>::type, false>::access(storage_);
 	}
 
-	Any& operator=(const Any& a)
+	template<class U>
+	const U& cast() const
 	{
-		if (ptr_ == a.ptr_)
-			return *this;
+		return const_cast<AnyBase_*>(this)->cast<U>();
+	}
 
-		ptr_ = a.clone();
-		tp_index_ = a.tp_index_;
-		return *this;
+	/** 类型不匹配时返回nullptr, 不输出诊断信息也不抛出异常 */
+	template<class U>
+	U* try_cast()
+	{
+		return is<U>() ? Manager_<typename std::remove_cv<U>::type, false>::access(storage_) : nullptr;
 	}
 
-private:
-	struct Base_;
-	typedef std::unique_ptr<Base_> BasePtr_;
+	template<class U>
+	const U* try_cast() const
+	{
+		return const_cast<AnyBase_*>(this)->try_cast<U>();
+	}
+
+protected:
+	friend class AnyRef;
+
+	/** 内联缓冲区宽度为三个指针, 放不下的对象存放在堆上, 此时只使用ptr */
+	union Storage_
+	{
+		void* ptr;
+		typename std::aligned_storage<3 * sizeof(void*), alignof(void*)>::type buf;
+	};
+
+	enum class Op_ { Copy, Move, Destroy, Access };
+
+	/**
+	 * 每个类型一个管理函数, 代替虚函数表: Copy和Move写入dst, Move之后self不再持有对象, Access将对象地址写入dst->ptr.
+	 * 内联储存的可平凡拷贝类型没有管理函数(manager_为nullptr), 拷贝和移动直接复制缓冲区, 销毁时什么也不做.
+	 */
+	using ManagerFunc_ = void (*)(Op_ op, Storage_& self, Storage_* dst);
 
-	struct Base_
+	/** 是否可以存放在内联缓冲区中: Move要求移动构造不抛异常 */
+	template<typename T>
+	struct IsSmall_ : std::integral_constant<bool, sizeof(T) <= sizeof(Storage_)
+		&& alignof(Storage_) % alignof(T) == 0
+		&& std::is_nothrow_move_constructible<T>::value>
 	{
-		virtual ~Base_() {}
-		virtual BasePtr_ clone() const = 0;
 	};
 
+	/** Copyable为false时(UniqueAny)不实例化拷贝构造, 因此可以存放只能移动的类型 */
 	template<typename T>
-	struct Derived : Base_
+	struct IsTrivial_ : std::integral_constant<bool, IsSmall_<T>::value && std::is_trivially_copyable<T>::value>
+	{
+	};
+
+	template<typename T, bool Copyable, bool = IsSmall_<T>::value>
+	struct Manager_
 	{
 		template<typename U>
-		Derived(U && value) : value(std::forward<U>(value)) { }
+		static void create(Storage_& s, AnyMemoryResource&, U && value)
+		{
+			new (&s.buf) T(std::forward<U>(value));
+		}
+
+		static T* access(Storage_& s)
+		{
+			return reinterpret_cast<T*>(&s.buf);
+		}
 
-		BasePtr_ clone() const
+		static void copy(Storage_& self, Storage_* dst, std::true_type)
 		{
-			return BasePtr_(new Derived<T>(value));
+			new (&dst->buf) T(*access(self));
 		}
 
-		T value;
+		static void copy(Storage_&, Storage_*, std::false_type) {}
+
+		static void manage(Op_ op, Storage_& self, Storage_* dst)
+		{
+			switch (op)
+			{
+			case Op_::Copy:
+				copy(self, dst, std::integral_constant<bool, Copyable>{});
+				break;
+			case Op_::Move:
+				new (&dst->buf) T(std::move(*access(self)));
+				access(self)->~T();
+				break;
+			case Op_::Destroy:
+				access(self)->~T();
+				break;
+			case Op_::Access:
+				dst->ptr = access(self);
+				break;
+			}
+		}
 	};
 
-	BasePtr_ clone() const
+	/** 堆上的对象之前记录着分配它的内存来源, storage_.ptr指向对象本身 */
+	template<typename T, bool Copyable>
+	struct Manager_<T, Copyable, false>
 	{
-		if (ptr_ != nullptr)
-			return ptr_->clone();
+		static constexpr size_t header_size = (sizeof(AnyMemoryResource*) + alignof(T) - 1) / alignof(T) * alignof(T);
+		static constexpr size_t block_size = header_size + sizeof(T);
+		static constexpr size_t block_align = alignof(T) > alignof(AnyMemoryResource*) ? alignof(T) : alignof(AnyMemoryResource*);
 
-		return nullptr;
+		template<typename U>
+		static void create(Storage_& s, AnyMemoryResource& resource, U && value)
+		{
+			char* block = static_cast<char*>(resource.allocate(block_size, block_align));
+			try
+			{
+				s.ptr = new (block + header_size) T(std::forward<U>(value));
+			}
+			catch (...)
+			{
+				resource.deallocate(block, block_size, block_align);
+				throw;
+			}
+			*reinterpret_cast<AnyMemoryResource**>(block) = &resource;
+#ifdef ZBASE_ANY_ACCOUNTING
+			AnyAccounting::allocated<T>(block_size);
+#endif
+		}
+
+		static T* access(Storage_& s)
+		{
+			return static_cast<T*>(s.ptr);
+		}
+
+		static void copy(Storage_& self, Storage_* dst, std::true_type)
+		{
+			create(*dst, anyCurrentResource(), *access(self));
+		}
+
+		static void copy(Storage_&, Storage_*, std::false_type) {}
+
+		static void destroy(Storage_& self)
+		{
+			char* block = static_cast<char*>(self.ptr) - header_size;
+			AnyMemoryResource* resource = *reinterpret_cast<AnyMemoryResource**>(block);
+			access(self)->~T();
+			resource->deallocate(block, block_size, block_align);
+#ifdef ZBASE_ANY_ACCOUNTING
+			AnyAccounting::deallocated<T>(block_size);
+#endif
+		}
+
+		static void manage(Op_ op, Storage_& self, Storage_* dst)
+		{
+			switch (op)
+			{
+			case Op_::Copy:
+				copy(self, dst, std::integral_constant<bool, Copyable>{});
+				break;
+			case Op_::Move:
+				dst->ptr = self.ptr;
+				break;
+			case Op_::Destroy:
+				destroy(self);
+				break;
+			case Op_::Access:
+				dst->ptr = access(self);
+				break;
+			}
+		}
+	};
+
+	template<typename U>
+	using Decay_ = typename std::decay<U>::type;
+
+	/** 值构造函数不接受Any和UniqueAny本身 */
+	template<typename U>
+	using EnableIfValue_ = typename std::enable_if<!std::is_base_of<AnyBase_, Decay_<U>>::value>::type;
+
+	AnyBase_(void) noexcept : manager_(nullptr), type_(anyTypeId<void>()) {}
+
+	~AnyBase_()
+	{
+		reset();
+	}
+
+	AnyBase_(const AnyBase_&) = delete;
+	AnyBase_& operator=(const AnyBase_&) = delete;
+
+	template<typename T, bool Copyable, typename U>
+	void construct(AnyMemoryResource& resource, U && value)
+	{
+		Manager_<T, Copyable>::create(storage_, resource, std::forward<U>(value));
+		manager_ = IsTrivial_<T>::value ? nullptr : &Manager_<T, Copyable>::manage;
+		type_ = anyTypeId<T>();
+	}
+
+	/** 要求*this为空且that由Any创建 */
+	void copyFrom(const AnyBase_& that)
+	{
+		if (that.manager_ != nullptr)
+			that.manager_(Op_::Copy, const_cast<Storage_&>(that.storage_), &storage_);
+		else
+			storage_ = that.storage_;
+		manager_ = that.manager_;
+		type_ = that.type_;
+	}
+
+	/** 要求*this为空, 之后that为空 */
+	void moveFrom(AnyBase_& that) noexcept
+	{
+		if (that.manager_ != nullptr)
+			that.manager_(Op_::Move, that.storage_, &storage_);
+		else
+			storage_ = that.storage_;
+		manager_ = that.manager_;
+		type_ = that.type_;
+		that.manager_ = nullptr;
+		that.type_ = anyTypeId<void>();
+	}
+
+	/** 储存的对象的地址, 为空时返回nullptr */
+	const void* data() const
+	{
+		if (manager_ == nullptr)
+			return isNull() ? nullptr : &storage_.buf;
+
+		Storage_ result;
+		manager_(Op_::Access, const_cast<Storage_&>(storage_), &result);
+		return result.ptr;
+	}
+
+	void reset() noexcept
+	{
+		if (manager_ != nullptr)
+			manager_(Op_::Destroy, storage_, nullptr);
+		manager_ = nullptr;
+		type_ = anyTypeId<void>();
 	}
 
-	BasePtr_ ptr_;
-	std::type_index tp_index_;
+	Storage_ storage_;
+	ManagerFunc_ manager_;
+	AnyTypeId type_;
+};
+
+/**
+ * \brief [API] Any类，可储存任何copyable的类型.
+ * \example
+ *      Any a = "const char*";
+ *      if(a.is<const char*>())
+ *          std::cout << a.cast<const char*>() << std::endl;
+ */
+struct Any : AnyBase_
+{
+	Any(void) {}
+
+	Any(const Any& that) : AnyBase_()
+	{
+		copyFrom(that);
+	}
+
+	Any(Any && that) noexcept : AnyBase_()
+	{
+		moveFrom(that);
+	}
+
+	/** 创建时，对于一般的类型，通过std::decay来移除引用和cv符，从而获取原始类型 */
+	template<typename U, class = EnableIfValue_<U>>
+	Any(U && value)
+	{
+		construct<Decay_<U>, true>(anyCurrentResource(), std::forward<U>(value));
+	}
+
+	/** 放不下内联缓冲区时从resource分配 */
+	template<typename U, class = EnableIfValue_<U>>
+	Any(std::allocator_arg_t, AnyMemoryResource& resource, U && value)
+	{
+		construct<Decay_<U>, true>(resource, std::forward<U>(value));
+	}
+
+	Any& operator=(const Any& a)
+	{
+		if (this == &a)
+			return *this;
+
+		/** 先完成拷贝再替换, 拷贝抛出异常时*this保持不变 */
+		Any tmp(a);
+		return *this = std::move(tmp);
+	}
+
+	Any& operator=(Any&& a) noexcept
+	{
+		if (this == &a)
+			return *this;
+
+		reset();
+		moveFrom(a);
+		return *this;
+	}
+};
+
+/**
+ * \brief [API] 只能移动的Any, 可储存std::unique_ptr等不可拷贝的类型.
+ * \note 所有权转移只移动内联缓冲区或堆指针, 永远不会拷贝储存的对象.
+ * \example
+ *      UniqueAny a = std::make_unique<int>(47);
+ *      UniqueAny b = std::move(a);                 // a为空
+ *      UniqueAny c = Any{47};                      // 也可以取走Any中的对象
+ */
+struct UniqueAny : AnyBase_
+{
+	UniqueAny(void) {}
+
+	UniqueAny(UniqueAny && that) noexcept : AnyBase_()
+	{
+		moveFrom(that);
+	}
+
+	UniqueAny(Any && that) noexcept : AnyBase_()
+	{
+		moveFrom(that);
+	}
+
+	template<typename U, class = EnableIfValue_<U>>
+	UniqueAny(U && value)
+	{
+		construct<Decay_<U>, false>(anyCurrentResource(), std::forward<U>(value));
+	}
+
+	template<typename U, class = EnableIfValue_<U>>
+	UniqueAny(std::allocator_arg_t, AnyMemoryResource& resource, U && value)
+	{
+		construct<Decay_<U>, false>(resource, std::forward<U>(value));
+	}
+
+	UniqueAny& operator=(UniqueAny&& a) noexcept
+	{
+		if (this == &a)
+			return *this;
+
+		reset();
+		moveFrom(a);
+		return *this;
+	}
+};
+
+/**
+ * \brief [API] Any的只读视图, 只包含对象地址和类型标识, 按值传递不会拷贝或分配.
+ * \note 不延长被引用对象的生命周期, 被引用的Any被修改或销毁后视图失效.
+ * \example
+ *      void handle(AnyRef field)
+ *      {
+ *          if(field.is<std::string>())
+ *              std::cout << field.cast<std::string>() << std::endl;
+ *      }
+ *      Any a = std::string{"string"};
+ *      handle(a);                              // 不调用拷贝
+ *      handle(std::string{"string"});          // 任何类型的对象都可以直接引用
+ */
+class AnyRef
+{
+public:
+	AnyRef(void) : ptr_(nullptr), type_(anyTypeId<void>()) {}
+
+	AnyRef(const AnyBase_& any) : ptr_(any.data()), type_(any.type()) {}
+
+	/** 引用SharedAny中储存的对象, 而不是SharedAny本身 */
+	AnyRef(const SharedAny& shared);
+
+	/** 包装类型(SharedAny, AtomicAny)不作为普通对象引用; AtomicAny须先取得快照 */
+	template<typename U, class = typename std::enable_if<!std::is_base_of<AnyBase_, U>::value
+		&& !std::is_same<U, AnyRef>::value && !std::is_same<U, SharedAny>::value
+		&& !std::is_same<U, AtomicAny>::value>::type>
+	AnyRef(const U& value) : ptr_(&value), type_(anyTypeId<U>()) {}
+
+	bool isNull() const { return ptr_ == nullptr; }
+
+	template<class U> bool is() const
+	{
+		return type_ == anyTypeId<U>();
+	}
+
+	AnyTypeId type() const
+	{
+		return type_;
+	}
+
+	template<class U>
+	const U& cast() const
+	{
+		if (!is<U>())
+			anyBadCast<U>(type_);
+
+		return *static_cast<const U*>(ptr_);
+	}
+
+	template<class U>
+	const U* try_cast() const
+	{
+		return is<U>() ? static_cast<const U*>(ptr_) : nullptr;
+	}
+
+	/** 被引用对象的地址 */
+	const void* data() const
+	{
+		return ptr_;
+	}
+
+	/** 先比较类型标识, 类型相同时才比较值; 类型不支持==时抛出std::logic_error */
+	friend bool operator==(AnyRef lhs, AnyRef rhs)
+	{
+		if (lhs.type_ != rhs.type_)
+			return false;
+		if (lhs.ptr_ == nullptr)
+			return true;
+		if (lhs.type_->equal == nullptr)
+			throw std::logic_error{"type stored in Any is not equality comparable"};
+		return lhs.type_->equal(lhs.ptr_, rhs.ptr_);
+	}
+
+	friend bool operator!=(AnyRef lhs, AnyRef rhs)
+	{
+		return !(lhs == rhs);
+	}
+
+	/** 类型不同时按类型标识排序, 该顺序在进程内稳定; 类型不支持<时抛出std::logic_error */
+	friend bool operator<(AnyRef lhs, AnyRef rhs)
+	{
+		if (lhs.type_ != rhs.type_)
+			return std::less<AnyTypeId>{}(lhs.type_, rhs.type_);
+		if (lhs.ptr_ == nullptr)
+			return false;
+		if (lhs.type_->less == nullptr)
+			throw std::logic_error{"type stored in Any is not less than comparable"};
+		return lhs.type_->less(lhs.ptr_, rhs.ptr_);
+	}
+
+	/** 类型标识参与哈希, 不同类型的相同值一般不会冲突; 类型不支持std::hash时抛出std::logic_error */
+	size_t hash() const
+	{
+		if (ptr_ == nullptr)
+			return 0;
+		if (type_->hash == nullptr)
+			throw std::logic_error{"type stored in Any is not hashable"};
+		return type_->hash(ptr_) ^ (size_t)(reinterpret_cast<uintptr_t>(type_) * 0x9e3779b97f4a7c15ull >> 16);
+	}
+
+private:
+	friend class AnyColumn;
+	friend class AnyRegistry;
+
+	AnyRef(AnyTypeId type, const void* ptr) : ptr_(ptr), type_(type) {}
+
+	const void* ptr_;
+	AnyTypeId type_;
+};
+
+#ifndef ZBASE_OVERLOADED_DEFINED
+#define ZBASE_OVERLOADED_DEFINED
+/** 把多个函数对象合并为一个重载集合, 由overloaded()创建 */
+template<typename... Funcs>
+struct Overloaded;
+
+template<typename Func>
+struct Overloaded<Func> : Func
+{
+	Overloaded(Func func) : Func(std::move(func)) {}
+
+	using Func::operator();
+};
+
+template<typename Func, typename... Rest>
+struct Overloaded<Func, Rest...> : Func, Overloaded<Rest...>
+{
+	Overloaded(Func func, Rest... rest) : Func(std::move(func)), Overloaded<Rest...>(std::move(rest)...) {}
+
+	using Func::operator();
+	using Overloaded<Rest...>::operator();
+};
+
+/**
+ * \brief [API] 把多个lambda合并为一个visitor.
+ * \example
+ *      auto visitor = overloaded([](int v) { ... }, [](const std::string& s) { ... });
+ */
+template<typename... Funcs>
+Overloaded<typename std::decay<Funcs>::type...> overloaded(Funcs&&... funcs)
+{
+	return Overloaded<typename std::decay<Funcs>::type...>(std::forward<Funcs>(funcs)...);
+}
+#endif
+
+/** visit的类型不在候选列表中时输出诊断信息并抛出std::bad_cast */
+[[noreturn]] inline void anyBadVisit(AnyTypeId actual)
+{
+#ifdef ZBASE_DIAGNOSTIC_HOOK
+	if (ZBaseDiagnosticHook hook = zbaseDiagnosticHook().load(std::memory_order_acquire))
+		hook("Any::visit", "visitor types", actual->name());
+#else
+	std::cout << "can not visit " << actual->name() << std::endl;
+#endif
+	throw std::bad_cast{};
+}
+
+/**
+ * \brief 类型标识到候选类型下标的开放寻址哈希表, 每组候选类型只构造一次.
+ * \note 类型标识是静态对象的地址, 编译期无法求值, 因此在第一次使用时建表.
+ */
+template<typename... Ts>
+class AnyVisitTable_
+{
+public:
+	static const AnyVisitTable_& instance()
+	{
+		static const AnyVisitTable_ table;
+		return table;
+	}
+
+	/** 返回下标, 不存在时返回-1 */
+	int find(AnyTypeId type) const
+	{
+		for (size_t slot = hash(type);; slot = (slot + 1) & (capacity - 1))
+		{
+			if (keys_[slot] == type)
+				return indexes_[slot];
+			if (keys_[slot] == nullptr)
+				return -1;
+		}
+	}
+
+private:
+	/** 装载因子不超过1/2 */
+	static constexpr size_t capacityFor(size_t n)
+	{
+		size_t capacity = 2;
+		while (capacity < 2 * n)
+			capacity *= 2;
+		return capacity;
+	}
+
+	static constexpr size_t log2(size_t n)
+	{
+		return n <= 1 ? 0 : 1 + log2(n / 2);
+	}
+
+	static constexpr size_t capacity = capacityFor(sizeof...(Ts));
+
+	/** 乘法哈希, 取乘积的高位 */
+	static size_t hash(AnyTypeId type)
+	{
+		return (size_t)((uint64_t(reinterpret_cast<uintptr_t>(type)) * 0x9e3779b97f4a7c15ull) >> (64 - log2(capacity)));
+	}
+
+	AnyVisitTable_()
+	{
+		for (size_t i = 0; i < capacity; ++i)
+			keys_[i] = nullptr;
+		const AnyTypeId types[] = { anyTypeId<Ts>()... };
+		for (size_t i = 0; i < sizeof...(Ts); ++i)
+		{
+			size_t slot = hash(types[i]);
+			while (keys_[slot] != nullptr && keys_[slot] != types[i])
+				slot = (slot + 1) & (capacity - 1);
+			if (keys_[slot] == nullptr)
+			{
+				keys_[slot] = types[i];
+				indexes_[slot] = int(i);
+			}
+		}
+	}
+
+	AnyTypeId keys_[capacity];
+	int indexes_[capacity];
+};
+
+/** 分派时类型已经确定, 按静态类型取得对象, 不经过管理函数 */
+template<typename T>
+T& anyVisitGet_(AnyBase_& any)
+{
+	return *any.try_cast<T>();
+}
+
+template<typename T>
+T& anyVisitGet_(const AnyBase_& any)
+{
+	return *any.try_cast<typename std::remove_const<T>::type>();
+}
+
+template<typename T>
+T& anyVisitGet_(AnyRef ref)
+{
+	return *static_cast<T*>(ref.data());
+}
+
+template<typename R, typename Visitor, typename Holder, typename T>
+R anyVisitCall_(Visitor& visitor, Holder& holder)
+{
+	return visitor(anyVisitGet_<T>(holder));
+}
+
+/** QualTs为带有const修饰(或不带)的候选类型, Holder为AnyBase_或AnyRef */
+template<typename... QualTs, typename Holder, typename Visitor>
+decltype(auto) anyVisit_(AnyTypeId type, Holder& holder, Visitor& visitor)
+{
+	using First = typename std::tuple_element<0, std::tuple<QualTs...>>::type;
+	using R = decltype(visitor(std::declval<First&>()));
+	static constexpr R (*calls[])(Visitor&, Holder&) = { &anyVisitCall_<R, Visitor, Holder, QualTs>... };
+
+	int index = AnyVisitTable_<typename std::remove_const<QualTs>::type...>::instance().find(type);
+	if (index < 0)
+		anyBadVisit(type);
+	return calls[index](visitor, holder);
+}
+
+/**
+ * \brief [API] 按Any中储存的类型调用visitor, 候选类型由Ts给出.
+ * \note 通过一次哈希查找得到下标, 再经过函数指针表间接调用一次, 与候选类型的数量无关.
+ *       所有分支的返回值类型须相同. 储存的类型不在Ts中时抛出std::bad_cast.
+ * \example
+ *      Any a = 47;
+ *      std::string s = visit<int, std::string>(a, overloaded(
+ *          [](int v) { return std::to_string(v); },
+ *          [](const std::string& v) { return v; }));
+ */
+template<typename... Ts, typename Visitor>
+decltype(auto) visit(AnyBase_& any, Visitor&& visitor)
+{
+	return anyVisit_<Ts...>(any.type(), any, visitor);
+}
+
+template<typename... Ts, typename Visitor>
+decltype(auto) visit(const AnyBase_& any, Visitor&& visitor)
+{
+	return anyVisit_<const Ts...>(any.type(), any, visitor);
+}
+
+/** 只接受AnyRef本身, 否则AnyRef的转换构造会使它参与所有两个参数的visit调用 */
+template<typename... Ts, typename Ref, typename Visitor,
+	class = typename std::enable_if<std::is_same<Ref, AnyRef>::value && (sizeof...(Ts) > 0)>::type>
+decltype(auto) visit(Ref ref, Visitor&& visitor)
+{
+	return anyVisit_<const Ts...>(ref.type(), ref, visitor);
+}
+
+/**
+ * \brief [API] 按类型分段连续存储的Any序列.
+ * \note 相邻的同类型元素存放在同一段的std::vector<T>中, 每段只记录一次类型标识,
+ *       因此用forEach<T>扫描同类型数据时是连续的内存访问, 可以被编译器向量化.
+ * \example
+ *      AnyColumn column;
+ *      for(int i = 0; i < 1000; ++i)
+ *          column.push_back(i);            // 1000个int共用一段
+ *      column.push_back(std::string{"end"});
+ *      long sum = 0;
+ *      column.forEach<int>([&](int v) { sum += v; });
+ *      AnyRef last = column[1000];         // last.is<std::string>()
+ */
+class AnyColumn
+{
+public:
+	AnyColumn(void) : size_(0) {}
+
+	template<typename U>
+	void push_back(U && value)
+	{
+		using T = typename std::decay<U>::type;
+		static_assert(!std::is_same<T, bool>::value, "std::vector<bool> is not contiguous, store char instead");
+
+		if (runs_.empty() || runs_.back().type != anyTypeId<T>())
+			runs_.push_back(Run_{anyTypeId<T>(), size_, 0, sizeof(T), &runData_<T>, UniqueAny{std::vector<T>{}}});
+		Run_& run = runs_.back();
+		run.values.cast<std::vector<T>>().push_back(std::forward<U>(value));
+		++run.size;
+		++size_;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+	void clear()
+	{
+		runs_.clear();
+		size_ = 0;
+	}
+
+	/** 二分查找所在的段 */
+	AnyRef operator[](size_t index) const
+	{
+		size_t lo = 0, hi = runs_.size();
+		while (hi - lo > 1)
+		{
+			size_t mid = (lo + hi) / 2;
+			if (runs_[mid].begin <= index)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		const Run_& run = runs_[lo];
+		return AnyRef(run.type, static_cast<const char*>(run.data(run.values)) + (index - run.begin) * run.elem_size);
+	}
+
+	size_t runCount() const
+	{
+		return runs_.size();
+	}
+
+	AnyTypeId runType(size_t run) const
+	{
+		return runs_[run].type;
+	}
+
+	size_t runSize(size_t run) const
+	{
+		return runs_[run].size;
+	}
+
+	/** 第run段的连续数据, 类型不匹配时返回nullptr */
+	template<class T>
+	T* runData(size_t run)
+	{
+		std::vector<T>* values = runs_[run].values.try_cast<std::vector<T>>();
+		return values != nullptr ? values->data() : nullptr;
+	}
+
+	template<class T>
+	const T* runData(size_t run) const
+	{
+		return const_cast<AnyColumn*>(this)->runData<T>(run);
+	}
+
+	/** 按顺序对所有类型为T的元素调用func(const T&), 每段内是一个紧凑的循环 */
+	template<class T, class Func>
+	void forEach(Func && func) const
+	{
+		for (const Run_& run : runs_)
+		{
+			if (run.type != anyTypeId<T>())
+				continue;
+			const T* data = static_cast<const T*>(run.data(run.values));
+			for (size_t i = 0, n = run.size; i < n; ++i)
+				func(data[i]);
+		}
+	}
+
+private:
+	struct Run_
+	{
+		AnyTypeId type;
+		size_t begin;                                   /**< 段内第一个元素在整个序列中的下标 */
+		size_t size;
+		size_t elem_size;
+		const void* (*data)(const UniqueAny& values);
+		UniqueAny values;                               /**< std::vector<T> */
+	};
+
+	template<typename T>
+	static const void* runData_(const UniqueAny& values)
+	{
+		return values.cast<std::vector<T>>().data();
+	}
+
+	std::vector<Run_> runs_;
+	size_t size_;
+};
+
+/**
+ * \brief [API] 写时拷贝的Any, 拷贝只增加引用计数, 只有通过非const的cast<T>()取得可修改的引用时才深拷贝.
+ * \note 引用计数是原子的, 不同线程可以同时拷贝和销毁指向同一个值的SharedAny,
+ *       但同一个SharedAny对象不能在多个线程中同时修改.
+ * \example
+ *      SharedAny event = std::string{"payload"};
+ *      for(auto& subscriber : subscribers)
+ *          subscriber.push(event);         // 每个订阅者O(1), 不拷贝字符串
+ *      event.cast<std::string>() += "!";   // 其他订阅者仍然持有, 此时才拷贝一份
+ */
+class SharedAny
+{
+public:
+	SharedAny(void) : node_(nullptr) {}
+
+	SharedAny(const SharedAny& that) noexcept : node_(that.node_)
+	{
+		if (node_ != nullptr)
+			node_->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	SharedAny(SharedAny && that) noexcept : node_(that.node_)
+	{
+		that.node_ = nullptr;
+	}
+
+	template<typename U, class = typename std::enable_if<!std::is_same<typename std::decay<U>::type, SharedAny>::value>::type>
+	SharedAny(U && value) : node_(new Node_(std::forward<U>(value))) {}
+
+	~SharedAny()
+	{
+		release();
+	}
+
+	SharedAny& operator=(const SharedAny& that) noexcept
+	{
+		SharedAny tmp(that);
+		return *this = std::move(tmp);
+	}
+
+	SharedAny& operator=(SharedAny&& that) noexcept
+	{
+		if (this == &that)
+			return *this;
+
+		release();
+		node_ = that.node_;
+		that.node_ = nullptr;
+		return *this;
+	}
+
+	bool isNull() const { return node_ == nullptr || node_->value.isNull(); }
+
+	template<class U> bool is() const
+	{
+		return type() == anyTypeId<U>();
+	}
+
+	AnyTypeId type() const
+	{
+		return node_ != nullptr ? node_->value.type() : anyTypeId<void>();
+	}
+
+	/** 共享的值, 只读 */
+	const Any& value() const
+	{
+		static const Any null;
+		return node_ != nullptr ? node_->value : null;
+	}
+
+	/** 只读访问, 不会拷贝 */
+	template<class U>
+	const U& cast() const
+	{
+		return value().cast<U>();
+	}
+
+	/** 可写访问, 值被共享时先拷贝一份 */
+	template<class U>
+	U& cast()
+	{
+		if (!is<U>())
+			anyBadCast<U>(type());
+
+		detach();
+		return node_->value.cast<U>();
+	}
+
+	template<class U>
+	const U* try_cast() const
+	{
+		return value().try_cast<U>();
+	}
+
+	template<class U>
+	U* try_cast()
+	{
+		if (!is<U>())
+			return nullptr;
+
+		detach();
+		return node_->value.try_cast<U>();
+	}
+
+	/** 按值比较, 见AnyRef. 定义为友元, 避免其他类型经由隐式转换匹配到 */
+	friend bool operator==(const SharedAny& lhs, const SharedAny& rhs)
+	{
+		return AnyRef(lhs.value()) == AnyRef(rhs.value());
+	}
+
+	friend bool operator!=(const SharedAny& lhs, const SharedAny& rhs)
+	{
+		return AnyRef(lhs.value()) != AnyRef(rhs.value());
+	}
+
+	friend bool operator<(const SharedAny& lhs, const SharedAny& rhs)
+	{
+		return AnyRef(lhs.value()) < AnyRef(rhs.value());
+	}
+
+	/** 共享同一个值的SharedAny的数量 */
+	size_t useCount() const
+	{
+		return node_ != nullptr ? node_->refs.load(std::memory_order_relaxed) : 0;
+	}
+
+private:
+	struct Node_
+	{
+		template<typename U>
+		explicit Node_(U && v) : refs(1), value(std::forward<U>(v)) {}
+
+		std::atomic<size_t> refs;
+		Any value;
+	};
+
+	/** 值被其他SharedAny共享时, 拷贝一份自己独占 */
+	void detach()
+	{
+		if (node_->refs.load(std::memory_order_acquire) == 1)
+			return;
+
+		Node_* copy = new Node_(node_->value);
+		release();
+		node_ = copy;
+	}
+
+	void release() noexcept
+	{
+		if (node_ != nullptr && node_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete node_;
+		node_ = nullptr;
+	}
+
+	Node_* node_;
+};
+
+inline AnyRef::AnyRef(const SharedAny& shared) : AnyRef(shared.value()) {}
+
+/** 按SharedAny中储存的类型调用visitor, 只读访问, 不会触发写时拷贝 */
+template<typename... Ts, typename Shared, typename Visitor,
+	class = typename std::enable_if<std::is_same<Shared, SharedAny>::value && (sizeof...(Ts) > 0)>::type>
+decltype(auto) visit(const Shared& shared, Visitor&& visitor)
+{
+	return visit<Ts...>(shared.value(), std::forward<Visitor>(visitor));
+}
+
+/** Any和UniqueAny按值比较, 见AnyRef */
+inline bool operator==(const AnyBase_& lhs, const AnyBase_& rhs)
+{
+	return AnyRef(lhs) == AnyRef(rhs);
+}
+
+inline bool operator!=(const AnyBase_& lhs, const AnyBase_& rhs)
+{
+	return AnyRef(lhs) != AnyRef(rhs);
+}
+
+inline bool operator<(const AnyBase_& lhs, const AnyBase_& rhs)
+{
+	return AnyRef(lhs) < AnyRef(rhs);
+}
+
+namespace std
+{
+	template<>
+	struct hash<AnyRef>
+	{
+		size_t operator()(AnyRef value) const
+		{
+			return value.hash();
+		}
+	};
+
+	template<>
+	struct hash<Any>
+	{
+		size_t operator()(const Any& value) const
+		{
+			return AnyRef(value).hash();
+		}
+	};
+
+	template<>
+	struct hash<SharedAny>
+	{
+		size_t operator()(const SharedAny& value) const
+		{
+			return AnyRef(value.value()).hash();
+		}
+	};
+}
+
+/**
+ * \brief [API] 类型的二进制编码. 默认支持可平凡拷贝的类型(按本机内存表示原样写入)和std::string,
+ *        其他类型可以特化该模板, 提供write和read, in_place为false.
+ *        指针和成员指针虽然可以平凡拷贝, 但其值只在本进程内有效, 默认不支持.
+ * \note in_place为true表示编码即内存表示, 反序列化时可以直接引用缓冲区中的数据.
+ */
+template<typename T, typename = void>
+struct AnySerializer;
+
+template<typename T>
+struct AnySerializer<T, typename std::enable_if<std::is_trivially_copyable<T>::value
+	&& !std::is_pointer<T>::value && !std::is_member_pointer<T>::value>::type>
+{
+	static constexpr bool in_place = true;
+
+	static void write(const T& value, std::string& out)
+	{
+		out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	static T read(const char* data, size_t size)
+	{
+		if (size != sizeof(T))
+			throw std::runtime_error{"AnySerializer: payload size mismatch"};
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type buf;
+		std::memcpy(&buf, data, sizeof(T));
+		return *reinterpret_cast<T*>(&buf);
+	}
+};
+
+template<>
+struct AnySerializer<std::string>
+{
+	static constexpr bool in_place = false;
+
+	static void write(const std::string& value, std::string& out)
+	{
+		out.append(value);
+	}
+
+	static std::string read(const char* data, size_t size)
+	{
+		return std::string(data, size);
+	}
+};
+
+/**
+ * \brief [API] 序列化类型注册表, 为每个类型指定一个跨进程稳定的编号.
+ * \note 每条记录为 [uint32 编号][uint32 长度][数据][补齐到8字节], 使用本机字节序.
+ *       记录相对缓冲区起始处8字节对齐, 因此对于8字节对齐(如mmap得到)的缓冲区,
+ *       对齐要求不超过8的in_place类型可以直接在缓冲区中引用, 不需要拷贝.
+ * \example
+ *      AnyRegistry registry;
+ *      registry.add<int>(1);
+ *      registry.add<std::string>(2);
+ *      std::string buf;
+ *      registry.write(Any{47}, buf);
+ *      size_t offset = 0;
+ *      AnyRef ref = registry.view(buf.data(), buf.size(), offset);   // 引用buf中的int
+ *      Any copy = registry.read(buf.data(), buf.size(), offset = 0); // 解码出一份拷贝
+ */
+class AnyRegistry
+{
+public:
+	static constexpr size_t record_align = 8;
+
+	/** 编号或类型重复注册时抛出std::logic_error */
+	template<typename T>
+	void add(uint32_t code)
+	{
+		if (by_code_.count(code) != 0 || by_type_.count(anyTypeId<T>()) != 0)
+			throw std::logic_error{"AnyRegistry: duplicate type or code"};
+
+		Entry_ entry = { code, anyTypeId<T>(), AnySerializer<T>::in_place && alignof(T) <= record_align,
+			alignof(T), &write_<T>, &read_<T> };
+		by_code_[code] = entries_.size();
+		by_type_[anyTypeId<T>()] = entries_.size();
+		entries_.push_back(entry);
+	}
+
+	/** 在out末尾追加一条记录, 类型未注册时抛出std::logic_error */
+	void write(AnyRef value, std::string& out) const
+	{
+		auto found = by_type_.find(value.type());
+		if (found == by_type_.end())
+			throw std::logic_error{"AnyRegistry: type is not registered"};
+		const Entry_& entry = entries_[found->second];
+
+		size_t header = out.size();
+		out.append(2 * sizeof(uint32_t), '\0');
+		entry.write(value.data(), out);
+		size_t size = out.size() - header - 2 * sizeof(uint32_t);
+		if (size > UINT32_MAX)
+			throw std::length_error{"AnyRegistry: payload too large"};
+		uint32_t fields[2] = { entry.code, uint32_t(size) };
+		std::memcpy(&out[header], fields, sizeof(fields));
+		out.append((record_align - out.size() % record_align) % record_align, '\0');
+	}
+
+	/** 解码offset处的记录并前进到下一条 */
+	Any read(const char* data, size_t size, size_t& offset) const
+	{
+		const char* payload;
+		uint32_t length;
+		const Entry_& entry = record(data, size, offset, payload, length);
+		Any value = entry.read(payload, length);
+		offset = next(offset, length);
+		return value;
+	}
+
+	/**
+	 * \brief 原地引用offset处的记录并前进到下一条, 不拷贝数据.
+	 * \return 记录不能原地引用(非in_place类型或地址未对齐)时返回空的AnyRef, 且offset不变, 此时应改用read.
+	 */
+	AnyRef view(const char* data, size_t size, size_t& offset) const
+	{
+		const char* payload;
+		uint32_t length;
+		const Entry_& entry = record(data, size, offset, payload, length);
+		if (!entry.in_place || reinterpret_cast<uintptr_t>(payload) % entry.align != 0)
+			return AnyRef{};
+		offset = next(offset, length);
+		return AnyRef(entry.type, payload);
+	}
+
+private:
+	struct Entry_
+	{
+		uint32_t code;
+		AnyTypeId type;
+		bool in_place;
+		size_t align;
+		void (*write)(const void* value, std::string& out);
+		Any (*read)(const char* data, size_t size);
+	};
+
+	template<typename T>
+	static void write_(const void* value, std::string& out)
+	{
+		AnySerializer<T>::write(*static_cast<const T*>(value), out);
+	}
+
+	template<typename T>
+	static Any read_(const char* data, size_t size)
+	{
+		return Any(AnySerializer<T>::read(data, size));
+	}
+
+	static size_t next(size_t offset, uint32_t length)
+	{
+		size_t end = offset + 2 * sizeof(uint32_t) + length;
+		return (end + record_align - 1) / record_align * record_align;
+	}
+
+	/** 解析记录头, 缓冲区不完整或编号未注册时抛出std::runtime_error */
+	const Entry_& record(const char* data, size_t size, size_t offset, const char*& payload, uint32_t& length) const
+	{
+		uint32_t fields[2];
+		if (offset > size || size - offset < sizeof(fields))
+			throw std::runtime_error{"AnyRegistry: truncated record"};
+		std::memcpy(fields, data + offset, sizeof(fields));
+		if (size - offset - sizeof(fields) < fields[1])
+			throw std::runtime_error{"AnyRegistry: truncated record"};
+		auto found = by_code_.find(fields[0]);
+		if (found == by_code_.end())
+			throw std::runtime_error{"AnyRegistry: unknown type code"};
+		payload = data + offset + sizeof(fields);
+		length = fields[1];
+		return entries_[found->second];
+	}
+
+	std::vector<Entry_> entries_;
+	std::unordered_map<uint32_t, size_t> by_code_;
+	std::unordered_map<AnyTypeId, size_t> by_type_;
+};
+
+/**
+ * \brief [API] 以字符串为键的Any属性表, 线性探测的开放寻址哈希表.
+ * \note 所有槽位(键, 哈希值和Any)在一块连续内存中, 不超过small_key字节的键和小对象值都存放在槽位内,
+ *       因此不超过initial_capacity * 3 / 4个条目的表只需要一次堆分配; 预计条目更多时先调用reserve(n).
+ *       插入和删除会使返回的指针失效.
+ * \example
+ *      AnyMap attrs;
+ *      attrs.reserve(2);
+ *      attrs["user"] = std::string{"lucklove"};
+ *      attrs["retry"] = 3;
+ *      if(Any* retry = attrs.find("retry"))
+ *          retry->cast<int>() += 1;
+ */
+class AnyMap
+{
+public:
+	static constexpr size_t small_key = 24;
+	static constexpr size_t initial_capacity = 8;
+
+	AnyMap(void) : slots_(nullptr), capacity_(0), size_(0) {}
+
+	AnyMap(const AnyMap& that) : AnyMap()
+	{
+		reserve(that.size_);
+		that.forEach([this](const char* key, size_t size, const Any& value)
+		{
+			(*this)(key, size) = value;
+		});
+	}
+
+	AnyMap(AnyMap&& that) noexcept : slots_(that.slots_), capacity_(that.capacity_), size_(that.size_)
+	{
+		that.slots_ = nullptr;
+		that.capacity_ = that.size_ = 0;
+	}
+
+	AnyMap& operator=(AnyMap that) noexcept
+	{
+		std::swap(slots_, that.slots_);
+		std::swap(capacity_, that.capacity_);
+		std::swap(size_, that.size_);
+		return *this;
+	}
+
+	~AnyMap()
+	{
+		delete[] slots_;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+	/** 槽位的数量, 条目超过它的3/4时扩容 */
+	size_t capacity() const
+	{
+		return capacity_;
+	}
+
+	/** 保证插入到n个条目之前不再扩容 */
+	void reserve(size_t n)
+	{
+		size_t capacity = initial_capacity;
+		while (n * 4 > capacity * 3)
+			capacity *= 2;
+		if (capacity > capacity_)
+			rehash(capacity);
+	}
+
+	/** 不存在时插入一个空的Any */
+	Any& operator()(const char* key, size_t size)
+	{
+		uint32_t hash = hashOf(key, size);
+		if (Slot_* slot = lookup(key, size, hash))
+			return slot->value;
+
+		if ((size_ + 1) * 4 > capacity_ * 3)
+			rehash(capacity_ == 0 ? initial_capacity : capacity_ * 2);
+		Slot_* slot = &slots_[hash & (capacity_ - 1)];
+		while (slot->hash != 0)
+			slot = next(slot);
+		slot->setKey(key, size, hash);
+		++size_;
+		return slot->value;
+	}
+
+	Any& operator[](const std::string& key)
+	{
+		return (*this)(key.data(), key.size());
+	}
+
+	Any& operator[](const char* key)
+	{
+		return (*this)(key, std::strlen(key));
+	}
+
+	/** 不存在时返回nullptr */
+	Any* find(const char* key, size_t size)
+	{
+		Slot_* slot = lookup(key, size, hashOf(key, size));
+		return slot != nullptr ? &slot->value : nullptr;
+	}
+
+	const Any* find(const char* key, size_t size) const
+	{
+		return const_cast<AnyMap*>(this)->find(key, size);
+	}
+
+	Any* find(const std::string& key)
+	{
+		return find(key.data(), key.size());
+	}
+
+	const Any* find(const std::string& key) const
+	{
+		return find(key.data(), key.size());
+	}
+
+	Any* find(const char* key)
+	{
+		return find(key, std::strlen(key));
+	}
+
+	const Any* find(const char* key) const
+	{
+		return find(key, std::strlen(key));
+	}
+
+	/** 删除后把同一探测序列上的后续条目前移, 不使用墓碑 */
+	bool erase(const char* key, size_t size)
+	{
+		Slot_* hole = lookup(key, size, hashOf(key, size));
+		if (hole == nullptr)
+			return false;
+
+		hole->clear();
+		--size_;
+		for (Slot_* slot = next(hole); slot->hash != 0; slot = next(slot))
+		{
+			Slot_* home = &slots_[slot->hash & (capacity_ - 1)];
+			/** home不在(hole, slot]之间时, slot可以前移到hole */
+			bool movable = hole <= slot ? (home <= hole || home > slot) : (home <= hole && home > slot);
+			if (movable)
+			{
+				hole->moveFrom(*slot);
+				hole = slot;
+			}
+		}
+		return true;
+	}
+
+	bool erase(const std::string& key)
+	{
+		return erase(key.data(), key.size());
+	}
+
+	void clear()
+	{
+		for (size_t i = 0; i < capacity_; ++i)
+			slots_[i].clear();
+		size_ = 0;
+	}
+
+	/** 以任意顺序对每个条目调用func(const char* key, size_t size, Any& value) */
+	template<typename Func>
+	void forEach(Func && func)
+	{
+		for (size_t i = 0; i < capacity_; ++i)
+		{
+			if (slots_[i].hash != 0)
+				func(slots_[i].key(), size_t(slots_[i].size), slots_[i].value);
+		}
+	}
+
+	template<typename Func>
+	void forEach(Func && func) const
+	{
+		const_cast<AnyMap*>(this)->forEach([&func](const char* key, size_t size, const Any& value)
+		{
+			func(key, size, value);
+		});
+	}
+
+private:
+	struct Slot_
+	{
+		Slot_(void) : hash(0), size(0) {}
+
+		~Slot_()
+		{
+			clear();
+		}
+
+		const char* key() const
+		{
+			return size <= small_key ? small : large;
+		}
+
+		void setKey(const char* key, size_t key_size, uint32_t key_hash)
+		{
+			char* dst = small;
+			if (key_size > small_key)
+				dst = large = new char[key_size];
+			std::memcpy(dst, key, key_size);
+			size = uint32_t(key_size);
+			hash = key_hash;
+		}
+
+		void clear()
+		{
+			if (hash != 0 && size > small_key)
+				delete[] large;
+			hash = size = 0;
+			value = Any{};
+		}
+
+		/** 要求*this为空 */
+		void moveFrom(Slot_& that) noexcept
+		{
+			hash = that.hash;
+			size = that.size;
+			std::memcpy(small, that.small, small_key);
+			value = std::move(that.value);
+			that.hash = that.size = 0;
+		}
+
+		uint32_t hash;                  /**< 最高位总为1, 0表示空槽位 */
+		uint32_t size;
+		union
+		{
+			char small[small_key];
+			char* large;
+		};
+		Any value;
+	};
+
+	/** FNV-1a */
+	static uint32_t hashOf(const char* key, size_t size)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ uint8_t(key[i])) * 16777619u;
+		return hash | 0x80000000u;
+	}
+
+	Slot_* next(Slot_* slot) const
+	{
+		return slot + 1 == slots_ + capacity_ ? slots_ : slot + 1;
+	}
+
+	Slot_* lookup(const char* key, size_t size, uint32_t hash) const
+	{
+		if (size_ == 0)
+			return nullptr;
+
+		for (Slot_* slot = &slots_[hash & (capacity_ - 1)]; slot->hash != 0; slot = next(slot))
+		{
+			if (slot->hash == hash && slot->size == size && std::memcmp(slot->key(), key, size) == 0)
+				return slot;
+		}
+		return nullptr;
+	}
+
+	void rehash(size_t capacity)
+	{
+		Slot_* old = slots_;
+		size_t old_capacity = capacity_;
+		slots_ = new Slot_[capacity];
+		capacity_ = capacity;
+		for (size_t i = 0; i < old_capacity; ++i)
+		{
+			if (old[i].hash == 0)
+				continue;
+			Slot_* slot = &slots_[old[i].hash & (capacity_ - 1)];
+			while (slot->hash != 0)
+				slot = next(slot);
+			slot->moveFrom(old[i]);
+		}
+		delete[] old;
+	}
+
+	Slot_* slots_;
+	size_t capacity_;
+	size_t size_;
+};
+
+/**
+ * \brief [API] 可以原子替换的Any, 用于发布配置快照.
+ * \note 与用户态RCU相同: 读者进入时在自己线程所属分片的计数器上加一, 离开时减一, 不加锁也不等待;
+ *       写者换入新值后等待两轮纪元内的读者全部离开, 再释放旧值, 写者之间用互斥锁串行.
+ *       持有Snapshot期间写者会一直等待, 因此不要长期持有.
+ * \example
+ *      AtomicAny config{Any{load_config()}};
+ *      // 读线程
+ *      {
+ *          AtomicAny::Snapshot snapshot = config.read();
+ *          use(snapshot->cast<Config>());
+ *      }
+ *      // 写线程
+ *      config.store(Any{load_config()});
+ */
+class AtomicAny
+{
+public:
+	static constexpr size_t stripe_count = 16;
+
+	/** 读者持有的一致快照, 析构时离开读临界区 */
+	class Snapshot
+	{
+	public:
+		Snapshot(Snapshot&& that) noexcept : value_(that.value_), readers_(that.readers_)
+		{
+			that.readers_ = nullptr;
+		}
+
+		Snapshot(const Snapshot&) = delete;
+		Snapshot& operator=(const Snapshot&) = delete;
+
+		~Snapshot()
+		{
+			if (readers_ != nullptr)
+				readers_->fetch_sub(1, std::memory_order_release);
+		}
+
+		const Any& operator*() const
+		{
+			return *value_;
+		}
+
+		const Any* operator->() const
+		{
+			return value_;
+		}
+
+	private:
+		friend class AtomicAny;
+
+		Snapshot(const Any* value, std::atomic<size_t>* readers) : value_(value), readers_(readers) {}
+
+		const Any* value_;
+		std::atomic<size_t>* readers_;
+	};
+
+	AtomicAny(void) : AtomicAny(Any{}) {}
+
+	explicit AtomicAny(Any value) : value_(new Any(std::move(value))), epoch_(0)
+	{
+		for (Stripe_& stripe : stripes_)
+			stripe.readers[0] = stripe.readers[1] = 0;
+	}
+
+	AtomicAny(const AtomicAny&) = delete;
+	AtomicAny& operator=(const AtomicAny&) = delete;
+
+	/** 要求没有存活的Snapshot */
+	~AtomicAny()
+	{
+		delete value_.load(std::memory_order_relaxed);
+	}
+
+	/** 无等待: 两次原子load和一次原子加 */
+	Snapshot read() const
+	{
+		Stripe_& stripe = stripes_[stripeIndex()];
+		std::atomic<size_t>& readers = stripe.readers[epoch_.load(std::memory_order_seq_cst) & 1];
+		readers.fetch_add(1, std::memory_order_seq_cst);
+		return Snapshot(value_.load(std::memory_order_seq_cst), &readers);
+	}
+
+	/** 拷贝一份当前值 */
+	Any load() const
+	{
+		return *read();
+	}
+
+	/** 换入新值, 等待读旧值的读者全部离开后释放旧值 */
+	void store(Any value)
+	{
+		Any* fresh = new Any(std::move(value));
+		std::lock_guard<std::mutex> lock(writer_);
+		Any* old = value_.exchange(fresh, std::memory_order_seq_cst);
+		synchronize();
+		delete old;
+	}
+
+private:
+	/** 读者所在的纪元可能是当前纪元或上一个纪元, 因此翻转两次, 每次等待旧纪元的计数归零 */
+	void synchronize()
+	{
+		for (int phase = 0; phase < 2; ++phase)
+		{
+			size_t epoch = epoch_.load(std::memory_order_relaxed);
+			epoch_.store(epoch + 1, std::memory_order_seq_cst);
+			for (Stripe_& stripe : stripes_)
+			{
+				while (stripe.readers[epoch & 1].load(std::memory_order_seq_cst) != 0)
+					std::this_thread::yield();
+			}
+		}
+	}
+
+	/** 每个线程固定使用一个分片, 分片独占缓存行, 避免读者之间争用 */
+	static size_t stripeIndex()
+	{
+		static std::atomic<size_t> next{0};
+		static thread_local size_t index = SIZE_MAX;
+		if (index == SIZE_MAX)
+			index = next.fetch_add(1, std::memory_order_relaxed) % stripe_count;
+		return index;
+	}
+
+	struct alignas(64) Stripe_
+	{
+		std::atomic<size_t> readers[2];
+	};
+
+	mutable Stripe_ stripes_[stripe_count];
+	std::atomic<Any*> value_;
+	std::atomic<size_t> epoch_;
+	std::mutex writer_;
 };
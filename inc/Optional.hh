@@ -2,158 +2,185 @@
 #include <type_traits>
 #include <utility>
 #include <exception>
+#include <stdexcept>
 
+/** 储存和构造/销毁操作, 不声明任何特殊成员函数 */
 template<typename T>
-class Optional
+class OptionalStorage_
 {
+protected:
     using data_t = typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type;
-public:
-    Optional() : has_init_(false) {}
 
-    Optional(const T& v)
-    {
-        create(v);
-    }
+    OptionalStorage_() : has_init_(false) {}
 
-    Optional(T&& v) : has_init_(false)
+    template<class... Args>
+    void create(Args&&... args)
     {
-        create(std::move(v));
-    }
+        new (&data_) T(std::forward<Args>
 
-    ~Optional()
-    {
-        destroy();
+            (args)...);
+        has_init_ = true;
     }
 
-    Optional(const Optional& other) : has_init_(false)
+    void destroy()
     {
-        if (other.isInit())
-            assign(other);
+        if (has_init_)
+        {
+            has_init_ = false;
+            ((T*) (&data_))->~T();
+        }
     }
 
-    Optional(Optional&& other) : has_init_(false)
+    void assign(const OptionalStorage_& other)
     {
-        if (other.isInit())
+        if (other.has_init_)
         {
-            assign(std::move(other));
-            other.destroy();
+            copy(other.data_);
+            has_init_ = true;
+        }
+        else
+        {
+            destroy();
         }
     }
 
-    Optional& operator=(Optional &&other)
+    void assign(OptionalStorage_&& other)
     {
-        assign(std::move(other));
-        return *this;
+        if (other.has_init_)
+        {
+            move(std::move(other.data_));
+            has_init_ = true;
+            other.destroy();
+        }
+        else
+        {
+            destroy();
+        }
     }
 
-    Optional& operator=(const Optional &other)
+    void move(data_t&& val)
     {
-        assign(other);
-        return *this;
+        destroy();
+        new (&data_) T(std::move(*((T*)(&val))));
     }
 
-    template<class... Args>
-    void emplace(Args&&... args)
+    void copy(const data_t& val)
     {
         destroy();
-        create(std::forward<Args>(args)...);
+        new (&data_) T(*((T*) (&val)));
     }
 
-    bool isInit() const { return has_init_; }
+    bool has_init_;
+    data_t data_;
+};
+
+/**
+ * \brief T可以平凡拷贝时, 拷贝, 移动和析构都由编译器生成(平凡的),
+ *        Optional<T>本身也可以平凡拷贝, std::vector可以直接memcpy, 传参时可以放在寄存器中.
+ */
+template<typename T, bool Trivial = std::is_trivially_copyable<T>::value>
+class OptionalBase_ : public OptionalStorage_<T>
+{
+};
+
+template<typename T>
+class OptionalBase_<T, false> : public OptionalStorage_<T>
+{
+public:
+    OptionalBase_() = default;
 
-    explicit operator bool() const 
+    ~OptionalBase_()
     {
-        return isInit();
+        this->destroy();
     }
 
-    T& operator*()
+    OptionalBase_(const OptionalBase_& other)
     {
-        return *((T*) (&data_));
+        if (other.has_init_)
+            this->assign(other);
     }
 
-    const T& operator*() const
+    OptionalBase_(OptionalBase_&& other)
     {
-        if (isInit())
-        {
-            return *((T*) (&data_));
-        }
+        if (other.has_init_)
+            this->assign(std::move(other));
+    }
 
-        throw std::logic_error{"try to get data in a Optional which is not init"};
+    OptionalBase_& operator=(OptionalBase_ &&other)
+    {
+        this->assign(std::move(other));
+        return *this;
     }
 
-    bool operator==(const Optional<T>& rhs) const
+    OptionalBase_& operator=(const OptionalBase_ &other)
     {
-        return (!bool(*this)) != (!rhs) ? false : (!bool(*this) ? true : (*(*this)) == (*rhs));
+        this->assign(other);
+        return *this;
     }
+};
 
-    bool operator<(const Optional<T>& rhs) const
+template<typename T>
+class Optional : private OptionalBase_<T>
+{
+public:
+    Optional() = default;
+
+    Optional(const T& v)
     {
-        return !rhs ? false : (!bool(*this) ? true : (*(*this) < (*rhs)));
+        this->create(v);
     }
 
-    bool operator!=(const Optional<T>& rhs)
+    Optional(T&& v)
     {
-        return !(*this == (rhs));
+        this->create(std::move(v));
     }
-private:
+
+    Optional(const Optional& other) = default;
+    Optional(Optional&& other) = default;
+    Optional& operator=(Optional &&other) = default;
+    Optional& operator=(const Optional &other) = default;
+
     template<class... Args>
-    void create(Args&&... args)
+    void emplace(Args&&... args)
     {
-        new (&data_) T(std::forward<Args>
-
-            (args)...);
-        has_init_ = true;
+        this->destroy();
+        this->create(std::forward<Args>(args)...);
     }
 
-    void destroy()
+    bool isInit() const { return this->has_init_; }
+
+    explicit operator bool() const
     {
-        if (has_init_)
-        {
-            has_init_ = false;
-            ((T*) (&data_))->~T();
-        }
+        return isInit();
     }
 
-    void assign(const Optional& other)
+    T& operator*()
     {
-        if (other.isInit())
-        {
-            copy(other.data_);
-            has_init_ = true;
-        }
-        else
-        {
-            destroy();
-        }
+        return *((T*) (&this->data_));
     }
 
-    void assign(Optional&& other)
+    const T& operator*() const
     {
-        if (other.isInit())
-        {
-            move(std::move(other.data_));
-            has_init_ = true;
-            other.destroy();
-        }
-        else
+        if (isInit())
         {
-            destroy();
+            return *((T*) (&this->data_));
         }
+
+        throw std::logic_error{"try to get data in a Optional which is not init"};
     }
 
-    void move(data_t&& val)
+    bool operator==(const Optional<T>& rhs) const
     {
-        destroy();
-        new (&data_) T(std::move(*((T*)(&val))));
+        return (!bool(*this)) != (!rhs) ? false : (!bool(*this) ? true : (*(*this)) == (*rhs));
     }
 
-    void copy(const data_t& val)
+    bool operator<(const Optional<T>& rhs) const
     {
-        destroy();
-        new (&data_) T(*((T*) (&val)));
+        return !rhs ? false : (!bool(*this) ? true : (*(*this) < (*rhs)));
     }
 
-private:
-    bool has_init_;
-    data_t data_;
+    bool operator!=(const Optional<T>& rhs)
+    {
+        return !(*this == (rhs));
+    }
 };
@@ -1,150 +1,473 @@
 #pragma once
 
 #include <typeindex>
+#include <functional>
+#include <type_traits>
+#include <cstdint>
+#include <atomic>
+#include <utility>
+#include <initializer_list>
+#include <tuple>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <new>
+#ifndef ZBASE_DIAGNOSTIC_HOOK
 #include <iostream>
+#endif
 
-/** 获取最大的整数 */
-template <size_t arg, size_t... rest>
-struct IntegerMax;
+#ifndef ZBASE_DIAGNOSTIC_DEFINED
+#define ZBASE_DIAGNOSTIC_DEFINED
+/**
+ * \brief [API] 诊断信息的输出钩子, what为出错的操作, expected和actual为类型名.
+ * \note 定义了ZBASE_DIAGNOSTIC_HOOK时, 类型不匹配的诊断信息不再写入std::cout, 而是交给这里设置的钩子(未设置时丢弃).
+ *       读取钩子只是一次原子load, 不会加锁.
+ * \example
+ *      zbaseDiagnosticHook().store([](const char* what, const char* expected, const char* actual)
+ *      {
+ *          lock_free_log_push(what, expected, actual);
+ *      });
+ */
+using ZBaseDiagnosticHook = void (*)(const char* what, const char* expected, const char* actual);
 
-template <size_t arg>
-struct IntegerMax<arg> : std::integral_constant<size_t, arg>
+inline std::atomic<ZBaseDiagnosticHook>& zbaseDiagnosticHook()
 {
-};
+	static std::atomic<ZBaseDiagnosticHook> hook{nullptr};
+	return hook;
+}
+#endif
+
+#ifndef ZBASE_OVERLOADED_DEFINED
+#define ZBASE_OVERLOADED_DEFINED
+/** 把多个函数对象合并为一个重载集合, 由overloaded()创建 */
+template<typename... Funcs>
+struct Overloaded;
 
-template <size_t arg1, size_t arg2, size_t... rest>
-struct IntegerMax<arg1, arg2, rest...> : std::integral_constant<size_t, arg1 >= arg2 ? IntegerMax<arg1, rest...>::value 
-    : IntegerMax<arg2, rest...>::value>
+template<typename Func>
+struct Overloaded<Func> : Func
 {
+	Overloaded(Func func) : Func(std::move(func)) {}
+
+	using Func::operator();
 };
 
-/** 获取最大的align */
-template<typename... Args>
-struct MaxAlign : std::integral_constant<int, IntegerMax<std::alignment_of<Args>::value...>::value>
+template<typename Func, typename... Rest>
+struct Overloaded<Func, Rest...> : Func, Overloaded<Rest...>
 {
+	Overloaded(Func func, Rest... rest) : Func(std::move(func)), Overloaded<Rest...>(std::move(rest)...) {}
+
+	using Func::operator();
+	using Overloaded<Rest...>::operator();
 };
 
-/** 是否包含某个类型 */
-template <typename T, typename... List>
-struct Contains;
+/**
+ * \brief [API] 把多个lambda合并为一个visitor.
+ * \example
+ *      auto visitor = overloaded([](int v) { ... }, [](const std::string& s) { ... });
+ */
+template<typename... Funcs>
+Overloaded<typename std::decay<Funcs>::type...> overloaded(Funcs&&... funcs)
+{
+	return Overloaded<typename std::decay<Funcs>::type...>(std::forward<Funcs>(funcs)...);
+}
+#endif
+
+/**
+ * 以下类型列表的操作都把参数包展开为一个std::initializer_list, 再由constexpr函数遍历,
+ * 实例化深度与候选类型的数量无关.
+ */
+constexpr size_t variantMaxOf_(std::initializer_list<size_t> values)
+{
+	size_t max = 0;
+	for (size_t value : values)
+		max = value > max ? value : max;
+	return max;
+}
+
+/** 第一个为true的位置, 不存在时返回-1 */
+constexpr int variantFindOf_(std::initializer_list<bool> values)
+{
+	int index = 0;
+	for (bool value : values)
+	{
+		if (value)
+			return index;
+		++index;
+	}
+	return -1;
+}
 
-template <typename T, typename Head, typename... Rest>
-struct Contains<T, Head, Rest...>
-	: std::conditional<std::is_same<T, Head>::value, std::true_type, Contains<T, Rest... >> ::type
+/** 获取最大的整数 */
+template <size_t arg, size_t... rest>
+struct IntegerMax : std::integral_constant<size_t, variantMaxOf_({arg, rest...})>
 {
 };
 
-template <typename T>
-struct Contains<T> : std::false_type
+/** 获取最大的align */
+template<typename... Args>
+struct MaxAlign : std::integral_constant<int, IntegerMax<std::alignment_of<Args>::value...>::value>
 {
 };
 
+/** 是否包含某个类型 */
 template <typename T, typename... List>
-struct IndexOf;
-
-template <typename T, typename Head, typename... Rest>
-struct IndexOf<T, Head, Rest...>
+struct Contains : std::integral_constant<bool, variantFindOf_({std::is_same<T, List>::value...}) >= 0>
 {
-	enum { value = IndexOf<T, Rest...>::value + 1 };
 };
 
-template <typename T, typename... Rest>
-struct IndexOf<T, T, Rest...>
+/** 类型在列表中第一次出现的位置, 不存在时为-1 */
+template <typename T, typename... List>
+struct IndexOf
 {
-	enum { value = 0 };
+	enum { value = variantFindOf_({std::is_same<T, List>::value...}) };
 };
 
-template <typename T>
-struct IndexOf<T>
+/** 每个类型和它的位置组成一个基类, 按位置做重载决议即可取出类型, 不需要逐个递归 */
+template<size_t I, typename T>
+struct AtLeaf_
 {
-	enum{value = -1};
+	using type = T;
 };
 
-template<int index, typename... Types>
-struct At;
+template<typename Indexes, typename... Types>
+struct AtSet_;
 
-template<int index, typename First, typename... Types>
-struct At<index, First, Types...>
+template<size_t... I, typename... Types>
+struct AtSet_<std::index_sequence<I...>, Types...> : AtLeaf_<I, Types>...
 {
-	using type = typename At<index - 1, Types...>::type;
 };
 
-template<typename T, typename... Types>
-struct At<0, T, Types...>
+template<size_t I, typename T>
+AtLeaf_<I, T> atLeaf_(const AtLeaf_<I, T>&);
+
+template<int index, typename... Types>
+struct At
 {
-	using type = T;
+	using type = typename decltype(atLeaf_<index>(std::declval<AtSet_<std::index_sequence_for<Types...>, Types...>>()))::type;
 };
 
+/** Variant的储存和按下标分派的操作, 不声明任何特殊成员函数 */
 template<typename... Types>
-class Variant
+class VariantStorage_
 {
+protected:
 	enum
 	{
 		data_size = IntegerMax<sizeof(Types)...>::value,
 		align_size = MaxAlign<Types...>::value
 	};
 	using data_t = typename std::aligned_storage<data_size, align_size>::type;
+	using index_t = typename std::conditional<(sizeof...(Types) < 255), uint8_t, uint16_t>::type;
+
+	/** 空Variant的下标 */
+	static constexpr index_t npos = index_t(-1);
+
+	VariantStorage_() : index_(npos)
+	{
+	}
+
+	/** 候选类型相同时使用对象自身的赋值, 不同时先构造新值再销毁旧值 */
+	void assign(const VariantStorage_& old)
+	{
+		if (this == &old)
+			return;
+		if (index_ == old.index_)
+		{
+			copyAssign(index_, &old.data_, &data_);
+			return;
+		}
+		const VariantStorage_* source = &old;
+		replace(old.index_, [this, source](void* buf) { copy(source->index_, &source->data_, buf); });
+	}
+
+	void assign(VariantStorage_&& old)
+	{
+		if (this == &old)
+			return;
+		if (index_ == old.index_)
+		{
+			moveAssign(index_, &old.data_, &data_);
+			return;
+		}
+		VariantStorage_* source = &old;
+		replace(old.index_, [this, source](void* buf) { move(source->index_, &source->data_, buf); });
+	}
+
+	/**
+	 * 新值的来源可能位于当前值之中(如把树节点替换为它的子节点), 因此先由build构造到临时储存中,
+	 * 再销毁当前值并移入新值; 移动抛出异常时Variant为空.
+	 */
+	template<typename Build>
+	void replace(index_t index, Build build)
+	{
+		data_t tmp;
+		build(&tmp);
+		destroy(index_, &data_);
+		index_ = npos;
+		try
+		{
+			move(index, &tmp, &data_);
+		}
+		catch (...)
+		{
+			destroy(index, &tmp);
+			throw;
+		}
+		destroy(index, &tmp);
+		index_ = index;
+	}
+
+	void destroy(index_t index, void* buf)
+	{
+		static constexpr void (*table[])(void*) = { &destroy0<Types>... };
+		if (index != npos)
+			table[index](buf);
+	}
+
+	template<typename T>
+	static void destroy0(void* data)
+	{
+		reinterpret_cast<T*>(data)->~T();
+	}
+
+	void move(index_t index, void* old_v, void* new_v)
+	{
+		static constexpr void (*table[])(void*, void*) = { &move0<Types>... };
+		if (index != npos)
+			table[index](old_v, new_v);
+	}
+
+	template<typename T>
+	static void move0(void* old_v, void* new_v)
+	{
+		new (new_v)T(std::move(*reinterpret_cast<T*>(old_v)));
+	}
+
+	void copy(index_t index, const void* old_v, void* new_v)
+	{
+		static constexpr void (*table[])(const void*, void*) = { &copy0<Types>... };
+		if (index != npos)
+			table[index](old_v, new_v);
+	}
+
+	template<typename T>
+	static void copy0(const void* old_v, void* new_v)
+	{
+		new (new_v)T(*reinterpret_cast<const T*>(old_v));
+	}
+
+	void moveAssign(index_t index, void* old_v, void* new_v)
+	{
+		static constexpr void (*table[])(void*, void*) = { &moveAssign0<Types>... };
+		if (index != npos)
+			table[index](old_v, new_v);
+	}
+
+	template<typename T>
+	static void moveAssign0(void* old_v, void* new_v)
+	{
+		*reinterpret_cast<T*>(new_v) = std::move(*reinterpret_cast<T*>(old_v));
+	}
+
+	void copyAssign(index_t index, const void* old_v, void* new_v)
+	{
+		static constexpr void (*table[])(const void*, void*) = { &copyAssign0<Types>... };
+		if (index != npos)
+			table[index](old_v, new_v);
+	}
+
+	template<typename T>
+	static void copyAssign0(const void* old_v, void* new_v)
+	{
+		*reinterpret_cast<T*>(new_v) = *reinterpret_cast<const T*>(old_v);
+	}
+
+	data_t data_;
+	index_t index_;
+};
+
+/**
+ * \brief 所有候选类型都可以平凡拷贝时, 拷贝, 移动和析构都由编译器生成(平凡的),
+ *        Variant本身也可以平凡拷贝, std::vector可以直接memcpy, 传参时可以放在寄存器中.
+ */
+template<bool Trivial, typename... Types>
+class VariantBase_ : public VariantStorage_<Types...>
+{
+};
+
+template<typename... Types>
+class VariantBase_<false, Types...> : public VariantStorage_<Types...>
+{
 public:
-	template<int index>
-	using IndexType = typename At<index, Types...>::type;
+	VariantBase_() = default;
 
-	Variant(void) :type_index_(typeid(void))
+	~VariantBase_()
 	{
+		this->destroy(this->index_, &this->data_);
 	}
 
-	~Variant()
+	VariantBase_(VariantBase_&& old)
 	{
-		destroy(type_index_, &data_);
+		this->move(old.index_, &old.data_, &this->data_);
+		this->index_ = old.index_;
 	}
 
-	Variant(Variant<Types...>&& old) : type_index_(old.type_index_)
+	VariantBase_(const VariantBase_& old)
 	{
-		move(old.type_index_, &old.data_, &data_);
+		this->copy(old.index_, &old.data_, &this->data_);
+		this->index_ = old.index_;
 	}
 
-	Variant(const Variant<Types...>& old) : type_index_(old.type_index_)
+	VariantBase_& operator=(const VariantBase_& old)
 	{
-		copy(old.type_index_, &old.data_, &data_);
+		this->assign(old);
+		return *this;
 	}
 
-	Variant& operator=(const Variant& old)
+	VariantBase_& operator=(VariantBase_&& old)
 	{
-		copy(old.type_index_, &old.data_, &data_);
-		type_index_ = old.type_index_;
+		this->assign(std::move(old));
 		return *this;
 	}
+};
+
+/**
+ * \brief [API] 就地构造的标记, 选择要构造的候选类型.
+ * \example
+ *      Variant<int, std::string> v(inPlaceType<std::string>, 100, 'a');   // 直接在Variant内构造std::string(100, 'a')
+ *      Variant<int, std::string> w(inPlaceIndex<0>, 47);
+ */
+template<typename T>
+struct InPlaceType
+{
+};
+
+template<size_t I>
+struct InPlaceIndex
+{
+};
+
+template<typename T>
+constexpr InPlaceType<T> inPlaceType{};
+
+template<size_t I>
+constexpr InPlaceIndex<I> inPlaceIndex{};
+
+/** 所有候选类型都可以平凡拷贝 */
+template<typename... Types>
+struct VariantTrivial_ : std::integral_constant<bool, !IntegerMax<!std::is_trivially_copyable<Types>::value...>::value>
+{
+};
 
-	Variant& operator=(Variant&& old)
+/**
+ * \brief [API] 多类型单值的容器.
+ * \note 当前类型以候选类型的下标记录(少于255个候选类型时只占一个字节),
+ *       销毁, 拷贝和移动通过以下标索引的函数指针表分派, 与候选类型的数量无关.
+ *       所有候选类型都可以平凡拷贝时, Variant也可以平凡拷贝.
+ */
+template<typename... Types>
+class Variant : private VariantBase_<VariantTrivial_<Types...>::value, Types...>
+{
+	using Storage_ = VariantStorage_<Types...>;
+	using typename Storage_::index_t;
+	using Storage_::npos;
+	using Storage_::data_;
+	using Storage_::index_;
+	using Storage_::destroy;
+public:
+	template<int index>
+	using IndexType = typename At<index, Types...>::type;
+
+	Variant(void) = default;
+	Variant(Variant<Types...>&& old) = default;
+	Variant(const Variant<Types...>& old) = default;
+	Variant& operator=(const Variant& old) = default;
+	Variant& operator=(Variant&& old) = default;
+
+	template <class T,
+	class = typename std::enable_if<Contains<typename std::decay<T>::type, Types...>::value>::type>
+	Variant& operator=(T&& value)
 	{
-		move(old.type_index_, &old.data_, &data_);
-		type_index_ = old.type_index_;
+		typedef typename std::decay<T>::type U;
+		if (is<U>())
+		{
+			*reinterpret_cast<U*>(&data_) = std::forward<T>(value);
+			return *this;
+		}
+		U tmp(std::forward<T>(value));    /**< value可能位于当前值之中, 先取出再销毁 */
+		destroy(index_, &data_);
+		index_ = npos;
+		new(&data_) U(std::move(tmp));
+		index_ = IndexOf<U, Types...>::value;
 		return *this;
 	}
 
 	template <class T,
 	class = typename std::enable_if<Contains<typename std::decay<T>::type, Types...>::value>::type>
-		Variant(T&& value) : type_index_(typeid(void))
+		Variant(T&& value)
 	{
-			destroy(type_index_, &data_);
 			typedef typename std::decay<T>::type U;
 			new(&data_) U(std::forward<T>(value));
-			type_index_ = std::type_index(typeid(U));
+			index_ = IndexOf<U, Types...>::value;
+	}
+
+	/** 用args直接在Variant内构造T, 不产生临时对象 */
+	template <class T, class... Args,
+	class = typename std::enable_if<Contains<T, Types...>::value>::type>
+	explicit Variant(InPlaceType<T>, Args&&... args)
+	{
+		new(&data_) T(std::forward<Args>(args)...);
+		index_ = IndexOf<T, Types...>::value;
+	}
+
+	template <size_t I, class... Args,
+	class = typename std::enable_if<(I < sizeof...(Types))>::type>
+	explicit Variant(InPlaceIndex<I>, Args&&... args)
+	{
+		new(&data_) IndexType<I>(std::forward<Args>(args)...);
+		index_ = I;
+	}
+
+	/** 销毁当前的值, 再用args直接构造T; 构造抛出异常时Variant为空 */
+	template <class T, class... Args,
+	class = typename std::enable_if<Contains<T, Types...>::value>::type>
+	T& emplace(Args&&... args)
+	{
+		return emplace<IndexOf<T, Types...>::value>(std::forward<Args>(args)...);
+	}
+
+	template <size_t I, class... Args,
+	class = typename std::enable_if<(I < sizeof...(Types))>::type>
+	IndexType<I>& emplace(Args&&... args)
+	{
+		destroy(index_, &data_);
+		index_ = npos;
+		new(&data_) IndexType<I>(std::forward<Args>(args)...);
+		index_ = I;
+		return *reinterpret_cast<IndexType<I>*>(&data_);
 	}
 
 	template<typename T>
 	bool is() const
 	{
-		return (type_index_ == std::type_index(typeid(T)));
+		return std::is_void<T>::value ? Empty() : int(index_) == IndexOf<T, Types...>::value;
 	}
 
 	bool Empty() const
 	{
-		return type_index_ == std::type_index(typeid(void));
+		return index_ == npos;
+	}
+
+	/** 当前类型的下标, 为空时返回-1 */
+	int index() const
+	{
+		return Empty() ? -1 : int(index_);
 	}
 
 	std::type_index type() const
 	{
-		return type_index_;
+		static const std::type_index types[] = { std::type_index(typeid(Types))... };
+		return Empty() ? std::type_index(typeid(void)) : types[index_];
 	}
 
 	template<typename T>
@@ -153,68 +476,966 @@ public:
 		using U = typename std::decay<T>::type;
 		if (!is<U>())
 		{
+#ifdef ZBASE_DIAGNOSTIC_HOOK
+			if (ZBaseDiagnosticHook hook = zbaseDiagnosticHook().load(std::memory_order_acquire))
+				hook("Variant::get", typeid(U).name(), type().name());
+#else
 			std::cout << typeid(U).name() << " is not defined. " 
-                << "current type is " << type_index_.name() << std::endl;
+                << "current type is " << type().name() << std::endl;
+#endif
 			throw std::bad_cast{};
 		}
 
 		return *(U*)(&data_);
 	}
 
+	/** 类型不匹配时返回nullptr, 不输出诊断信息也不抛出异常 */
+	template<typename T>
+	typename std::decay<T>::type* get_if()
+	{
+		using U = typename std::decay<T>::type;
+		return is<U>() ? (U*)(&data_) : nullptr;
+	}
+
+	template<typename T>
+	const typename std::decay<T>::type* get_if() const
+	{
+		using U = typename std::decay<T>::type;
+		return is<U>() ? (const U*)(&data_) : nullptr;
+	}
+
 	template <typename T>
 	int indexOf()
 	{
 		return IndexOf<T, Types...>::value;
 	}
 
+	/** 候选类型相同时比较值, 两个空Variant相等 */
 	bool operator==(const Variant& rhs) const
 	{
-		return type_index_ == rhs.type_index_;
+		static constexpr bool (*table[])(const void*, const void*) = { &equal0<Types>... };
+		return index_ == rhs.index_ && (Empty() || table[index_](&data_, &rhs.data_));
 	}
 
+	bool operator!=(const Variant& rhs) const
+	{
+		return !(*this == rhs);
+	}
+
+	/** 先按候选类型的下标排序(空Variant最小), 下标相同时比较值 */
 	bool operator<(const Variant& rhs) const
 	{
-		return type_index_ < rhs.type_index_;
+		static constexpr bool (*table[])(const void*, const void*) = { &less0<Types>... };
+		if (index_ != rhs.index_)
+			return index() < rhs.index();
+		return !Empty() && table[index_](&data_, &rhs.data_);
 	}
 
-private:
-	void destroy(const std::type_index& index, void * buf)
+	/** 候选类型的下标参与哈希, 不同类型的相同值一般不会冲突 */
+	size_t hash() const
 	{
-        [](auto&&...){}((destroy0<Types>(index, buf), 0)...);
+		static constexpr size_t (*table[])(const void*) = { &hash0<Types>... };
+		if (Empty())
+			return 0;
+		return table[index_](&data_) ^ (size_t)((uint64_t(index_) + 1) * 0x9e3779b97f4a7c15ull >> 16);
 	}
 
+private:
+	friend struct VariantAccess_;
+
 	template<typename T>
-	void destroy0(const std::type_index& id, void* data)
+	static bool equal0(const void* lhs, const void* rhs)
 	{
-		if (id == std::type_index(typeid(T)))
-			reinterpret_cast<T*>(data)->~T();
+		return *reinterpret_cast<const T*>(lhs) == *reinterpret_cast<const T*>(rhs);
 	}
 
-	void move(const std::type_index& old_t, void* old_v, void* new_v) 
+	template<typename T>
+	static bool less0(const void* lhs, const void* rhs)
 	{
-        [](auto&&...){}((move0<Types>(old_t, old_v, new_v), 0)...);
+		return *reinterpret_cast<const T*>(lhs) < *reinterpret_cast<const T*>(rhs);
 	}
 
 	template<typename T>
-	void move0(const std::type_index& old_t, void* old_v, void* new_v)
+	static size_t hash0(const void* value)
 	{
-		if (old_t == std::type_index(typeid(T)))
-			new (new_v)T(std::move(*reinterpret_cast<T*>(old_v)));
+		return std::hash<T>{}(*reinterpret_cast<const T*>(value));
 	}
+};
+
+namespace std
+{
+	template<typename... Types>
+	struct hash<Variant<Types...>>
+	{
+		size_t operator()(const Variant<Types...>& value) const
+		{
+			return value.hash();
+		}
+	};
+}
+
+template<typename V>
+struct VariantSize_;
+
+/** 候选类型的数量 */
+template<typename... Types>
+struct VariantSize_<Variant<Types...>> : std::integral_constant<size_t, sizeof...(Types)>
+{
+};
+
+template<typename... Types>
+struct VariantSize_<const Variant<Types...>> : VariantSize_<Variant<Types...>>
+{
+};
+
+template<typename... Vs>
+struct IsVariant_;
+
+template<>
+struct IsVariant_<> : std::true_type
+{
+};
+
+template<typename V, typename... Rest>
+struct IsVariant_<V, Rest...> : std::false_type
+{
+};
+
+template<typename... Types, typename... Rest>
+struct IsVariant_<Variant<Types...>, Rest...> : IsVariant_<Rest...>
+{
+};
 
-	void copy(const std::type_index& old_t, void* old_v, void* new_v)
+/** 按下标取得对象, 调用前下标已经确定, 不再检查 */
+struct VariantAccess_
+{
+	template<size_t I, typename... Types>
+	static typename At<I, Types...>::type& get(Variant<Types...>& v)
 	{
-        [](auto&&...){}((copy0<Types>(old_t, old_v, new_v), 0)...);
+		return *reinterpret_cast<typename At<I, Types...>::type*>(&v.data_);
 	}
 
-	template<typename T>
-	void copy0(const std::type_index& old_t, void* old_v, void* new_v)
+	template<size_t I, typename... Types>
+	static const typename At<I, Types...>::type& get(const Variant<Types...>& v)
 	{
-		if (old_t == std::type_index(typeid(T)))
-			new (new_v)T(*reinterpret_cast<const T*>(old_v));
+		return *reinterpret_cast<const typename At<I, Types...>::type*>(&v.data_);
 	}
+};
 
-private:
-	data_t data_;
-	std::type_index type_index_;
+/** visit的Variant为空时输出诊断信息并抛出std::bad_cast */
+[[noreturn]] inline void variantBadVisit()
+{
+#ifdef ZBASE_DIAGNOSTIC_HOOK
+	if (ZBaseDiagnosticHook hook = zbaseDiagnosticHook().load(std::memory_order_acquire))
+		hook("Variant::visit", "non-empty variant", typeid(void).name());
+#else
+	std::cout << "can not visit an empty variant" << std::endl;
+#endif
+	throw std::bad_cast{};
+}
+
+/** 多个Variant的下标组合按行优先展开为一维下标, 返回第k个Variant的步长 */
+template<typename... Vs>
+constexpr size_t variantStride_(size_t k)
+{
+	const size_t sizes[] = { VariantSize_<Vs>::value... };
+	size_t stride = 1;
+	for (size_t i = k + 1; i < sizeof...(Vs); ++i)
+		stride *= sizes[i];
+	return stride;
+}
+
+/** 类型组合的总数 */
+template<typename... Vs>
+constexpr size_t variantCombinations_()
+{
+	const size_t sizes[] = { VariantSize_<Vs>::value... };
+	size_t count = 1;
+	for (size_t size : sizes)
+		count *= size;
+	return count;
+}
+
+/** 一维下标Flat对应的调用, Vs为带有const修饰(或不带)的Variant类型 */
+template<typename R, size_t Flat, typename Visitor, typename... Vs>
+struct VariantVisitCall_
+{
+	template<size_t... K>
+	static R call(std::index_sequence<K...>, Visitor& visitor, Vs&... vs)
+	{
+		return visitor(VariantAccess_::get<(Flat / variantStride_<Vs...>(K)) % VariantSize_<Vs>::value>(vs)...);
+	}
+
+	static R invoke(Visitor& visitor, Vs&... vs)
+	{
+		return call(std::index_sequence_for<Vs...>{}, visitor, vs...);
+	}
 };
+
+/** 组合较多时通过函数指针表分派 */
+template<typename R, typename Visitor, typename... Vs, size_t... Flat>
+R variantVisitTable_(std::index_sequence<Flat...>, size_t index, Visitor& visitor, Vs&... vs)
+{
+	static constexpr R (*calls[])(Visitor&, Vs&...) = { &VariantVisitCall_<R, Flat, Visitor, Vs...>::invoke... };
+	return calls[index](visitor, vs...);
+}
+
+/** 组合不超过64种时逐个比较下标: 每个条件分支单独预测, 比一次间接跳转更容易预测, visitor也被内联 */
+template<typename R, typename Visitor, typename... Vs, size_t Flat, size_t... Rest>
+R variantVisitChain_(std::index_sequence<Flat, Rest...>, size_t index, Visitor& visitor, Vs&... vs)
+{
+	if (sizeof...(Rest) == 0 || index == Flat)
+		return VariantVisitCall_<R, Flat, Visitor, Vs...>::invoke(visitor, vs...);
+	return variantVisitChain_<R>(std::index_sequence<Rest...>{}, index, visitor, vs...);
+}
+
+template<typename R, typename Visitor, typename... Vs>
+R variantVisitChain_(std::index_sequence<>, size_t, Visitor&, Vs&...)
+{
+	variantBadVisit();
+}
+
+/** 按组合的数量选择分派方式: 0为比较链, 1为函数指针表 */
+template<size_t Count>
+using VariantVisitKind_ = std::integral_constant<int, (Count <= 64 ? 0 : 1)>;
+
+template<typename R, typename Visitor, typename... Vs, size_t... Flat>
+R variantVisit_(std::integral_constant<int, 0>, std::index_sequence<Flat...> combinations, size_t index, Visitor& visitor, Vs&... vs)
+{
+	return variantVisitChain_<R>(combinations, index, visitor, vs...);
+}
+
+template<typename R, typename Visitor, typename... Vs, size_t... Flat>
+R variantVisit_(std::integral_constant<int, 1>, std::index_sequence<Flat...> combinations, size_t index, Visitor& visitor, Vs&... vs)
+{
+	return variantVisitTable_<R>(combinations, index, visitor, vs...);
+}
+
+/**
+ * \brief [API] 按Variant中储存的类型调用visitor, 传入多个Variant时按类型的组合调用.
+ * \note 组合不超过64种时逐个比较下标, visitor被内联, 与手写的is<T>()判断链相同;
+ *       更多的组合在编译期生成一张函数指针表, 分派只是一次间接调用.
+ *       visitor的返回类型由第一个候选类型(的组合)决定, 任意一个Variant为空时输出诊断信息并抛出std::bad_cast.
+ * \example
+ *      Variant<int, std::string> v = 47;
+ *      visit(overloaded([](int i) { ... }, [](const std::string& s) { ... }), v);
+ *      visit([](const auto& a, const auto& b) { ... }, v1, v2);
+ */
+template<typename Visitor, typename... Vs,
+	class = typename std::enable_if<(sizeof...(Vs) > 0) && IsVariant_<typename std::decay<Vs>::type...>::value>::type>
+decltype(auto) visit(Visitor&& visitor, Vs&&... vs)
+{
+	using R = decltype(visitor(VariantAccess_::get<0>(vs)...));
+	const size_t sizes[] = { VariantSize_<typename std::remove_reference<Vs>::type>::value... };
+	const int indexes[] = { vs.index()... };
+	size_t index = 0;
+	for (size_t k = 0; k < sizeof...(Vs); ++k)
+	{
+		if (indexes[k] < 0)
+			variantBadVisit();
+		index = index * sizes[k] + size_t(indexes[k]);
+	}
+	constexpr size_t count = variantCombinations_<typename std::remove_reference<Vs>::type...>();
+	return variantVisit_<R>(VariantVisitKind_<count>{}, std::make_index_sequence<count>{}, index, visitor, vs...);
+}
+
+/**
+ * \brief [API] 按候选类型分列存储的Variant序列.
+ * \note 每个元素只记录一个字节(或两个字节)的下标和它在所属类型数组中的位置, 值存放在该类型的std::vector<T>中,
+ *       不再按最大的候选类型补齐. visit_all按类型逐个扫描连续的数组, 因此访问顺序是按类型分组的, 不是插入顺序.
+ * \example
+ *      VariantVector<int, double, std::string> values;
+ *      values.push_back(47);
+ *      values.push_back(std::string{"string"});
+ *      values.visit_all(overloaded([](int& i) { ... }, [](double& d) { ... }, [](std::string& s) { ... }));
+ *      std::cout << values.bytes() << " vs " << values.variantBytes() << std::endl;
+ */
+template<typename... Types>
+class VariantVector
+{
+	using index_t = typename std::conditional<(sizeof...(Types) < 255), uint8_t, uint16_t>::type;
+public:
+	static_assert(!Contains<bool, Types...>::value, "std::vector<bool> is not contiguous, store char instead");
+
+	template <class T,
+	class = typename std::enable_if<Contains<typename std::decay<T>::type, Types...>::value>::type>
+	void push_back(T&& value)
+	{
+		using U = typename std::decay<T>::type;
+		std::vector<U>& column = std::get<IndexOf<U, Types...>::value>(columns_);
+		if (column.size() >= std::numeric_limits<uint32_t>::max())
+			throw std::length_error{"VariantVector: too many elements of one type"};
+		/** 先放入值, 下标或类型记录失败时撤销, 三个数组始终一致 */
+		column.push_back(std::forward<T>(value));
+		try
+		{
+			slots_.push_back(uint32_t(column.size() - 1));
+			tags_.push_back(index_t(IndexOf<U, Types...>::value));
+		}
+		catch (...)
+		{
+			if (slots_.size() > tags_.size())
+				slots_.pop_back();
+			column.pop_back();
+			throw;
+		}
+	}
+
+	/** 空的Variant无法存放, 抛出std::bad_cast */
+	void push_back(const Variant<Types...>& value)
+	{
+		::visit([this](const auto& v) { this->push_back(v); }, value);
+	}
+
+	size_t size() const
+	{
+		return tags_.size();
+	}
+
+	bool empty() const
+	{
+		return tags_.empty();
+	}
+
+	void clear()
+	{
+		tags_.clear();
+		slots_.clear();
+		clearColumns(std::index_sequence_for<Types...>{});
+	}
+
+	/** 第i个元素的候选类型下标 */
+	int index(size_t i) const
+	{
+		return int(tags_[i]);
+	}
+
+	template<typename T>
+	T* get_if(size_t i)
+	{
+		enum { I = IndexOf<T, Types...>::value };
+		return tags_[i] == I ? &std::get<I>(columns_)[slots_[i]] : nullptr;
+	}
+
+	template<typename T>
+	const T* get_if(size_t i) const
+	{
+		enum { I = IndexOf<T, Types...>::value };
+		return tags_[i] == I ? &std::get<I>(columns_)[slots_[i]] : nullptr;
+	}
+
+	/** 第i个元素复制为Variant */
+	Variant<Types...> at(size_t i) const
+	{
+		return visit(i, [](const auto& v) { return Variant<Types...>{v}; });
+	}
+
+	/** 按第i个元素的类型调用visitor, 返回类型由第一个候选类型决定 */
+	template<typename Visitor>
+	decltype(auto) visit(size_t i, Visitor&& visitor)
+	{
+		return visitAt<VariantVector>(*this, i, visitor);
+	}
+
+	template<typename Visitor>
+	decltype(auto) visit(size_t i, Visitor&& visitor) const
+	{
+		return visitAt<const VariantVector>(*this, i, visitor);
+	}
+
+	/** 按类型逐列调用visitor, 同一类型的元素在一个紧凑的循环中处理 */
+	template<typename Visitor>
+	void visit_all(Visitor&& visitor)
+	{
+		visitColumns(columns_, visitor, std::index_sequence_for<Types...>{});
+	}
+
+	template<typename Visitor>
+	void visit_all(Visitor&& visitor) const
+	{
+		visitColumns(columns_, visitor, std::index_sequence_for<Types...>{});
+	}
+
+	/** 类型为T的元素数量 */
+	template<typename T>
+	size_t count() const
+	{
+		return std::get<IndexOf<T, Types...>::value>(columns_).size();
+	}
+
+	/** 按元素数量计算的内存占用(不含vector预留的容量) */
+	size_t bytes() const
+	{
+		const size_t columns[] = { std::get<IndexOf<Types, Types...>::value>(columns_).size() * sizeof(Types)... };
+		size_t total = tags_.size() * (sizeof(index_t) + sizeof(uint32_t));
+		for (size_t column : columns)
+			total += column;
+		return total;
+	}
+
+	/** 同样的元素存放在std::vector<Variant<Types...>>中的内存占用 */
+	size_t variantBytes() const
+	{
+		return tags_.size() * sizeof(Variant<Types...>);
+	}
+
+private:
+	template<typename Self, typename Visitor>
+	static decltype(auto) visitAt(Self& self, size_t i, Visitor& visitor)
+	{
+		return visitAt_<Self>(self, i, visitor, std::index_sequence_for<Types...>{});
+	}
+
+	template<typename Self, typename Visitor, size_t... I>
+	static decltype(auto) visitAt_(Self& self, size_t i, Visitor& visitor, std::index_sequence<I...>)
+	{
+		using R = decltype(visitor(std::get<0>(self.columns_)[0]));
+		static constexpr R (*calls[])(Self&, size_t, Visitor&) = { &visitOne<Self, Visitor, R, I>... };
+		return calls[self.tags_[i]](self, i, visitor);
+	}
+
+	template<typename Self, typename Visitor, typename R, size_t I>
+	static R visitOne(Self& self, size_t i, Visitor& visitor)
+	{
+		return visitor(std::get<I>(self.columns_)[self.slots_[i]]);
+	}
+
+	template<typename Columns, typename Visitor, size_t... I>
+	static void visitColumns(Columns& columns, Visitor& visitor, std::index_sequence<I...>)
+	{
+		int expand[] = { (visitColumn(std::get<I>(columns), visitor), 0)... };
+		(void)expand;
+	}
+
+	template<typename Column, typename Visitor>
+	static void visitColumn(Column& column, Visitor& visitor)
+	{
+		for (auto& value : column)
+			visitor(value);
+	}
+
+	template<size_t... I>
+	void clearColumns(std::index_sequence<I...>)
+	{
+		int expand[] = { (std::get<I>(columns_).clear(), 0)... };
+		(void)expand;
+	}
+
+	std::vector<index_t> tags_;
+	std::vector<uint32_t> slots_;    /**< 元素在所属类型数组中的位置 */
+	std::tuple<std::vector<Types>...> columns_;
+};
+
+/**
+ * \brief [API] PackedVariant中候选类型的编码方式, 可以为自定义类型特化.
+ * \note encode的结果中最低的spare_bits位必须为0, PackedVariant把候选类型的下标存放在这些位中;
+ *       decode收到的值中这些位已经清零. 没有特化的类型不能作为PackedVariant的候选类型.
+ * \example
+ *      struct Handle { uint16_t id; };
+ *      template<>
+ *      struct VariantNiche<Handle>
+ *      {
+ *          static constexpr unsigned spare_bits = 16;
+ *          static uintptr_t encode(Handle h) { return uintptr_t(h.id) << 16; }
+ *          static Handle decode(uintptr_t word) { return Handle{uint16_t(word >> 16)}; }
+ *      };
+ */
+template<typename T, typename = void>
+struct VariantNiche;
+
+constexpr unsigned variantLog2_(size_t n)
+{
+	return n <= 1 ? 0 : 1 + variantLog2_(n / 2);
+}
+
+/** 指针的低位由指向类型的对齐保证为0 */
+template<typename T>
+struct VariantNiche<T*, typename std::enable_if<!std::is_void<T>::value>::type>
+{
+	static constexpr unsigned spare_bits = variantLog2_(alignof(T));
+
+	static uintptr_t encode(T* ptr)
+	{
+		return reinterpret_cast<uintptr_t>(ptr);
+	}
+
+	static T* decode(uintptr_t word)
+	{
+		return reinterpret_cast<T*>(word);
+	}
+};
+
+/** 比指针窄的整数存放在高位, 低位空出 */
+template<typename T>
+struct VariantNiche<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value
+	&& (sizeof(T) < sizeof(uintptr_t))>::type>
+{
+	static constexpr unsigned spare_bits = 8 * (sizeof(uintptr_t) - sizeof(T));
+
+	static uintptr_t encode(T value)
+	{
+		return uintptr_t(typename std::make_unsigned<T>::type(value)) << spare_bits;
+	}
+
+	static T decode(uintptr_t word)
+	{
+		return T(typename std::make_unsigned<T>::type(word >> spare_bits));
+	}
+};
+
+/** bool只有一位有效, 存放在最高位 */
+template<>
+struct VariantNiche<bool>
+{
+	static constexpr unsigned spare_bits = 8 * sizeof(uintptr_t) - 1;
+
+	static uintptr_t encode(bool value)
+	{
+		return uintptr_t(value) << spare_bits;
+	}
+
+	static bool decode(uintptr_t word)
+	{
+		return (word >> spare_bits) != 0;
+	}
+};
+
+/**
+ * \brief [API] 把下标压缩到候选类型空闲位中的Variant, 只占一个指针的大小.
+ * \note 候选类型按值存取, 必须有VariantNiche的特化, 且每个候选类型的spare_bits都要能容纳下标
+ *       (下标加1后存放, 0表示空). 例如PackedVariant<Node*, Leaf*, int32_t>需要2位,
+ *       Node和Leaf的对齐至少为4; 不满足时在构造处编译失败.
+ * \example
+ *      PackedVariant<Node*, Leaf*, int32_t> child = leaf;     // sizeof(child) == sizeof(void*)
+ *      if(child.is<Leaf*>())
+ *          Leaf* l = child.get<Leaf*>();
+ *      visit(overloaded([](Node* n) { ... }, [](Leaf* l) { ... }, [](int32_t v) { ... }), child);
+ */
+template<typename... Types>
+class PackedVariant
+{
+	static constexpr unsigned tag_bits = variantLog2_(sizeof...(Types)) + 1;
+	static constexpr uintptr_t tag_mask = (uintptr_t(1) << tag_bits) - 1;
+public:
+	PackedVariant(void) : word_(0)
+	{
+	}
+
+	template <class T,
+	class = typename std::enable_if<Contains<typename std::decay<T>::type, Types...>::value>::type>
+	PackedVariant(const T& value) : word_(encode(value))
+	{
+	}
+
+	template <class T,
+	class = typename std::enable_if<Contains<typename std::decay<T>::type, Types...>::value>::type>
+	PackedVariant& operator=(const T& value)
+	{
+		word_ = encode(value);
+		return *this;
+	}
+
+	template<typename T>
+	bool is() const
+	{
+		return std::is_void<T>::value ? Empty() : int(word_ & tag_mask) == IndexOf<T, Types...>::value + 1;
+	}
+
+	bool Empty() const
+	{
+		return (word_ & tag_mask) == 0;
+	}
+
+	/** 当前类型的下标, 为空时返回-1 */
+	int index() const
+	{
+		return int(word_ & tag_mask) - 1;
+	}
+
+	template<typename T>
+	T get() const
+	{
+		if (!is<T>())
+		{
+#ifdef ZBASE_DIAGNOSTIC_HOOK
+			if (ZBaseDiagnosticHook hook = zbaseDiagnosticHook().load(std::memory_order_acquire))
+				hook("PackedVariant::get", typeid(T).name(), "another alternative");
+#else
+			std::cout << typeid(T).name() << " is not the current type of PackedVariant" << std::endl;
+#endif
+			throw std::bad_cast{};
+		}
+		return VariantNiche<T>::decode(word_ & ~tag_mask);
+	}
+
+	bool operator==(const PackedVariant& rhs) const
+	{
+		return word_ == rhs.word_;
+	}
+
+	bool operator!=(const PackedVariant& rhs) const
+	{
+		return word_ != rhs.word_;
+	}
+
+private:
+	template<typename... Ts, typename Visitor>
+	friend decltype(auto) visit(Visitor&& visitor, const PackedVariant<Ts...>& v);
+
+	template<typename T>
+	static uintptr_t encode(const T& value)
+	{
+		static_assert(VariantNiche<T>::spare_bits >= tag_bits, "alternative has no room for the PackedVariant index");
+		return VariantNiche<T>::encode(value) | uintptr_t(IndexOf<T, Types...>::value + 1);
+	}
+
+	/** 空闲位只能容纳很少的候选类型, 总是逐个比较下标, 以便编译器内联visitor */
+	template<typename R, typename Visitor, size_t I, size_t... Rest>
+	static R dispatch(std::index_sequence<I, Rest...>, Visitor& visitor, int index, uintptr_t word)
+	{
+		if (sizeof...(Rest) == 0 || index == int(I))
+			return visitor(VariantNiche<typename At<I, Types...>::type>::decode(word));
+		return dispatch<R>(std::index_sequence<Rest...>{}, visitor, index, word);
+	}
+
+	template<typename R, typename Visitor>
+	static R dispatch(std::index_sequence<>, Visitor&, int, uintptr_t)
+	{
+		variantBadVisit();
+	}
+
+	template<typename Visitor>
+	decltype(auto) dispatch(Visitor& visitor) const
+	{
+		using R = decltype(visitor(VariantNiche<typename At<0, Types...>::type>::decode(0)));
+		if (Empty())
+			variantBadVisit();
+		return dispatch<R>(std::index_sequence_for<Types...>{}, visitor, index(), word_ & ~tag_mask);
+	}
+
+	uintptr_t word_;
+};
+
+/** 按PackedVariant中储存的类型调用visitor, 候选类型按值传入 */
+template<typename... Types, typename Visitor>
+decltype(auto) visit(Visitor&& visitor, const PackedVariant<Types...>& v)
+{
+	return v.dispatch(visitor);
+}
+
+#ifndef ZBASE_MEMORY_RESOURCE_DEFINED
+#define ZBASE_MEMORY_RESOURCE_DEFINED
+/**
+ * \brief [API] Any的大对象和VariantBox中的对象从这里分配内存.
+ * \note 对象之前记录了其内存来源, 因此释放时总是归还给分配它的那个resource.
+ *       Any.hh和Variant.hh共用这一组类型, 同一个内存池可以同时服务两者.
+ */
+struct ZBaseMemoryResource
+{
+	virtual void* allocate(size_t size, size_t align) = 0;
+	virtual void deallocate(void* p, size_t size, size_t align) noexcept = 0;
+	virtual ~ZBaseMemoryResource() = default;
+};
+
+/** 默认的内存来源, 即operator new/delete */
+struct ZBaseNewDeleteResource : ZBaseMemoryResource
+{
+	constexpr ZBaseNewDeleteResource() {}
+
+	void* allocate(size_t size, size_t) override
+	{
+		return ::operator new(size);
+	}
+
+	void deallocate(void* p, size_t, size_t) noexcept override
+	{
+		::operator delete(p);
+	}
+
+	static ZBaseNewDeleteResource& instance()
+	{
+		static ZBaseNewDeleteResource resource;
+		return resource;
+	}
+};
+
+/**
+ * \brief [API] 单调递增的内存池, 从大块内存中顺序分配, deallocate什么也不做, release()或析构时一次性释放.
+ * \note 调用release()之前, 必须先销毁所有从该内存池分配的对象. 大块内存来自upstream, 默认为operator new.
+ * \example
+ *      ZBaseArena arena;
+ *      {
+ *          ZBaseResourceScope scope(arena);    // 本线程接下来的分配都来自arena
+ *          handle_request();
+ *      }
+ *      arena.release();
+ */
+class ZBaseArena : public ZBaseMemoryResource
+{
+public:
+	explicit ZBaseArena(size_t block_size = 64 * 1024, ZBaseMemoryResource& upstream = ZBaseNewDeleteResource::instance())
+		: blocks_(nullptr), cur_(nullptr), end_(nullptr), block_size_(block_size), upstream_(upstream) {}
+
+	ZBaseArena(const ZBaseArena&) = delete;
+	ZBaseArena& operator=(const ZBaseArena&) = delete;
+
+	~ZBaseArena()
+	{
+		release();
+	}
+
+	void* allocate(size_t size, size_t align) override
+	{
+		char* p = alignUp(cur_, align);
+		if (cur_ == nullptr || p + size > end_)
+		{
+			grow(size + align);
+			p = alignUp(cur_, align);
+		}
+		cur_ = p + size;
+		return p;
+	}
+
+	void deallocate(void*, size_t, size_t) noexcept override {}
+
+	void release() noexcept
+	{
+		while (blocks_ != nullptr)
+		{
+			Block_* next = blocks_->next;
+			upstream_.deallocate(blocks_, blocks_->size, alignof(Block_));
+			blocks_ = next;
+		}
+		cur_ = end_ = nullptr;
+	}
+
+private:
+	struct Block_
+	{
+		Block_* next;
+		size_t size;
+	};
+
+	static char* alignUp(char* p, size_t align)
+	{
+		return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~(uintptr_t)(align - 1));
+	}
+
+	/** 超过block_size_的请求单独分配一块 */
+	void grow(size_t min_size)
+	{
+		size_t size = sizeof(Block_) + (min_size > block_size_ ? min_size : block_size_);
+		Block_* block = static_cast<Block_*>(upstream_.allocate(size, alignof(Block_)));
+		block->next = blocks_;
+		block->size = size;
+		blocks_ = block;
+		cur_ = reinterpret_cast<char*>(block + 1);
+		end_ = reinterpret_cast<char*>(block) + size;
+	}
+
+	Block_* blocks_;
+	char* cur_;
+	char* end_;
+	size_t block_size_;
+	ZBaseMemoryResource& upstream_;
+};
+
+/** 当前线程的内存来源, nullptr表示ZBaseNewDeleteResource */
+inline ZBaseMemoryResource*& zbaseThreadResource()
+{
+	static thread_local ZBaseMemoryResource* resource = nullptr;
+	return resource;
+}
+
+inline ZBaseMemoryResource& zbaseCurrentResource()
+{
+	ZBaseMemoryResource* resource = zbaseThreadResource();
+	return resource != nullptr ? *resource : ZBaseNewDeleteResource::instance();
+}
+
+/** \brief [API] 在作用域内把当前线程的内存来源替换为resource, 包括拷贝时的分配. */
+class ZBaseResourceScope
+{
+public:
+	explicit ZBaseResourceScope(ZBaseMemoryResource& resource) : prev_(zbaseThreadResource())
+	{
+		zbaseThreadResource() = &resource;
+	}
+
+	ZBaseResourceScope(const ZBaseResourceScope&) = delete;
+	ZBaseResourceScope& operator=(const ZBaseResourceScope&) = delete;
+
+	~ZBaseResourceScope()
+	{
+		zbaseThreadResource() = prev_;
+	}
+
+private:
+	ZBaseMemoryResource* prev_;
+};
+#endif
+
+/**
+ * \brief [API] 把T放在当前内存来源上的值语义盒子, 用于定义递归的Variant.
+ * \note VariantBox<T>只有一个指针大小, 定义时T可以是不完整类型. 拷贝时在当前线程的内存来源上深拷贝,
+ *       移动只转移指针(移动后为空). 比较和哈希转发给T.
+ * \example
+ *      struct Array;
+ *      using Json = Variant<double, std::string, VariantBox<Array>>;
+ *      struct Array { std::vector<Json> items; };
+ *
+ *      ZBaseArena arena;
+ *      ZBaseResourceScope scope(arena);      // 整棵树的节点都从arena的大块内存中分配
+ *      Json doc = VariantBox<Array>{Array{}};
+ */
+template<typename T>
+class VariantBox
+{
+public:
+	VariantBox(const T& value) : ptr_(create(value))
+	{
+	}
+
+	VariantBox(T&& value) : ptr_(create(std::move(value)))
+	{
+	}
+
+	VariantBox(const VariantBox& other) : ptr_(other.ptr_ != nullptr ? create(*other.ptr_) : nullptr)
+	{
+	}
+
+	VariantBox(VariantBox&& other) noexcept : ptr_(other.ptr_)
+	{
+		other.ptr_ = nullptr;
+	}
+
+	VariantBox& operator=(const VariantBox& other)
+	{
+		if (this != &other)
+		{
+			VariantBox copy(other);
+			std::swap(ptr_, copy.ptr_);
+		}
+		return *this;
+	}
+
+	VariantBox& operator=(VariantBox&& other) noexcept
+	{
+		if (this != &other)
+		{
+			/** other可能位于当前的对象之中, 先取走它的指针再销毁当前的对象 */
+			T* old = ptr_;
+			ptr_ = other.ptr_;
+			other.ptr_ = nullptr;
+			if (old != nullptr)
+				destroy(old);
+		}
+		return *this;
+	}
+
+	~VariantBox()
+	{
+		if (ptr_ != nullptr)
+			destroy(ptr_);
+	}
+
+	/** 被移动后为空 */
+	bool empty() const
+	{
+		return ptr_ == nullptr;
+	}
+
+	T& operator*()
+	{
+		return *ptr_;
+	}
+
+	const T& operator*() const
+	{
+		return *ptr_;
+	}
+
+	T* operator->()
+	{
+		return ptr_;
+	}
+
+	const T* operator->() const
+	{
+		return ptr_;
+	}
+
+	/** 被移动后为空的盒子: 两个空盒子相等, 空盒子小于任何非空的盒子 */
+	bool operator==(const VariantBox& rhs) const
+	{
+		if (ptr_ == nullptr || rhs.ptr_ == nullptr)
+			return ptr_ == rhs.ptr_;
+		return *ptr_ == *rhs.ptr_;
+	}
+
+	bool operator<(const VariantBox& rhs) const
+	{
+		if (ptr_ == nullptr || rhs.ptr_ == nullptr)
+			return ptr_ == nullptr && rhs.ptr_ != nullptr;
+		return *ptr_ < *rhs.ptr_;
+	}
+
+private:
+	/** T之前的对齐空间记录分配它的内存来源; 写成函数, 使定义VariantBox<T>时不需要T的大小 */
+	static constexpr size_t headerSize()
+	{
+		return (sizeof(ZBaseMemoryResource*) + alignof(T) - 1) / alignof(T) * alignof(T);
+	}
+
+	static constexpr size_t blockSize()
+	{
+		return headerSize() + sizeof(T);
+	}
+
+	static constexpr size_t blockAlign()
+	{
+		return alignof(T) > alignof(ZBaseMemoryResource*) ? alignof(T) : alignof(ZBaseMemoryResource*);
+	}
+
+	template<typename U>
+	static T* create(U&& value)
+	{
+		ZBaseMemoryResource& resource = zbaseCurrentResource();
+		char* block = static_cast<char*>(resource.allocate(blockSize(), blockAlign()));
+		T* ptr;
+		try
+		{
+			ptr = new (block + headerSize()) T(std::forward<U>(value));
+		}
+		catch (...)
+		{
+			resource.deallocate(block, blockSize(), blockAlign());
+			throw;
+		}
+		*reinterpret_cast<ZBaseMemoryResource**>(block) = &resource;
+		return ptr;
+	}
+
+	static void destroy(T* ptr)
+	{
+		char* block = reinterpret_cast<char*>(ptr) - headerSize();
+		ZBaseMemoryResource* resource = *reinterpret_cast<ZBaseMemoryResource**>(block);
+		ptr->~T();
+		resource->deallocate(block, blockSize(), blockAlign());
+	}
+
+	T* ptr_;
+};
+
+namespace std
+{
+	template<typename T>
+	struct hash<VariantBox<T>>
+	{
+		/** 空盒子的哈希值为0 */
+		size_t operator()(const VariantBox<T>& value) const
+		{
+			return value.empty() ? 0 : std::hash<T>{}(*value);
+		}
+	};
+}
@@ -1,6 +1,14 @@
 #include "UnitTest.hh"
 #include <iostream>
 #include "Any.hh"
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 TEST_CASE(any_test)
 {
@@ -16,3 +24,477 @@ TEST_CASE(any_test)
     TEST_REQUIRE(a.is<std::string>());
     TEST_CHECK(a.cast<std::string>() == "string");
 }
+
+TEST_CASE(any_small_buffer_test)
+{
+    Any small = 47;
+    Any big = std::string(100, 'a');
+    Any small_copy = small;
+    Any big_copy = big;
+    TEST_CHECK(small_copy.cast<int>() == 47);
+    TEST_REQUIRE(big_copy.is<std::string>());
+    TEST_CHECK(big_copy.cast<std::string>().size() == 100);
+    big_copy.cast<std::string>()[0] = 'b';
+    TEST_CHECK(big.cast<std::string>()[0] == 'a');           /**< 拷贝是深拷贝 */
+
+    Any moved = std::move(small_copy);
+    TEST_CHECK(moved.cast<int>() == 47);
+    TEST_CHECK(small_copy.isNull());
+    TEST_CHECK(small_copy.is<void>());
+    moved = std::move(big_copy);
+    TEST_CHECK(moved.cast<std::string>()[0] == 'b');
+    TEST_CHECK(big_copy.isNull());
+    moved = small;
+    TEST_CHECK(moved.cast<int>() == 47);
+}
+
+TEST_CASE(any_type_tag_test)
+{
+    Any a = 47;
+    const Any b = std::string{"string"};
+    TEST_CHECK(a.type() == anyTypeId<int>());
+    TEST_CHECK(a.type() == anyTypeId<const int&>());     /**< 与typeid一致, 忽略引用和cv */
+    TEST_CHECK(b.type() != a.type());
+    TEST_CHECK(Any{}.type() == anyTypeId<void>());
+    TEST_CHECK(a.is<const int>());
+    a.cast<const int>();
+    bool thrown = false;
+    try
+    {
+        a.cast<long>();
+    }
+    catch (std::bad_cast&)
+    {
+        thrown = true;
+    }
+    TEST_CHECK(thrown);
+}
+
+TEST_CASE(unique_any_test)
+{
+    UniqueAny a = std::make_unique<int>(47);
+    TEST_REQUIRE(a.is<std::unique_ptr<int>>());
+    int* raw = a.cast<std::unique_ptr<int>>().get();
+    UniqueAny b = std::move(a);
+    TEST_CHECK(a.isNull());
+    TEST_CHECK(b.cast<std::unique_ptr<int>>().get() == raw);   /**< 所有权转移不拷贝对象 */
+
+    UniqueAny c = Any{std::string{"string"}};
+    TEST_CHECK(c.cast<std::string>() == "string");
+    c = std::move(b);
+    TEST_CHECK(*c.cast<std::unique_ptr<int>>() == 47);
+    TEST_CHECK(!std::is_copy_constructible<UniqueAny>::value);
+}
+
+/** 统计分配和释放次数的内存来源 */
+struct CountingResource : AnyMemoryResource
+{
+    size_t allocated = 0;
+    size_t deallocated = 0;
+
+    void* allocate(size_t size, size_t align) override
+    {
+        ++allocated;
+        return arena.allocate(size, align);
+    }
+
+    void deallocate(void* p, size_t size, size_t align) noexcept override
+    {
+        ++deallocated;
+    }
+
+    AnyArena arena{256};
+};
+
+TEST_CASE(any_memory_resource_test)
+{
+    CountingResource resource;
+    {
+        Any a{std::allocator_arg, resource, std::string(100, 'a')};
+        Any small{std::allocator_arg, resource, 47};        /**< 小对象不使用resource */
+        TEST_CHECK(resource.allocated == 1);
+        Any copy = a;                                       /**< 拷贝从当前线程的内存来源分配 */
+        TEST_CHECK(resource.allocated == 1);
+        {
+            AnyResourceScope scope(resource);
+            Any scoped = std::string(100, 'x');
+            Any scoped_copy = a;
+            TEST_CHECK(resource.allocated == 3);
+            TEST_CHECK(scoped_copy.cast<std::string>()[99] == 'a');
+        }
+        TEST_CHECK(resource.deallocated == 2);
+        Any moved = std::move(a);                           /**< 移动不重新分配 */
+        TEST_CHECK(resource.allocated == 3);
+        TEST_CHECK(moved.cast<std::string>().size() == 100);
+    }
+    TEST_CHECK(resource.deallocated == 3);
+}
+
+static size_t any_ref_length(AnyRef ref)
+{
+    return ref.is<std::string>() ? ref.cast<std::string>().size() : 0;
+}
+
+TEST_CASE(any_ref_test)
+{
+    TEST_CHECK(std::is_trivially_copyable<AnyRef>::value);
+    Any small = 47;
+    const Any big = std::string(100, 'a');
+    AnyRef small_ref = small;
+    AnyRef big_ref = big;
+    TEST_CHECK(&small_ref.cast<int>() == &small.cast<int>());   /**< 引用原对象, 不拷贝 */
+    TEST_CHECK(&big_ref.cast<std::string>() == &big.cast<std::string>());
+    TEST_CHECK(any_ref_length(big) == 100);
+    TEST_CHECK(any_ref_length(std::string{"string"}) == 6);
+    TEST_CHECK(any_ref_length(small) == 0);
+
+    UniqueAny unique = std::make_unique<int>(47);
+    TEST_CHECK(*AnyRef{unique}.cast<std::unique_ptr<int>>() == 47);
+    TEST_CHECK(AnyRef{}.isNull());
+    TEST_CHECK(AnyRef{Any{}}.is<void>());
+}
+
+TEST_CASE(any_try_cast_test)
+{
+    Any a = 47;
+    const Any b = std::string{"string"};
+    TEST_REQUIRE(a.try_cast<int>() != nullptr);
+    TEST_CHECK(*a.try_cast<int>() == 47);
+    TEST_CHECK(a.try_cast<long>() == nullptr);
+    TEST_CHECK(b.try_cast<std::string>()->size() == 6);
+    TEST_CHECK(AnyRef{b}.try_cast<int>() == nullptr);
+    TEST_CHECK(Any{}.try_cast<int>() == nullptr);
+    TEST_CHECK(anyHeapSnapshot().empty());                  /**< 未定义ZBASE_ANY_ACCOUNTING */
+}
+
+TEST_CASE(any_column_test)
+{
+    AnyColumn column;
+    for (int i = 0; i < 100; ++i)
+        column.push_back(i);
+    column.push_back(std::string{"string"});
+    column.push_back(1.5);
+    column.push_back(100);
+    TEST_CHECK(column.size() == 103);
+    TEST_REQUIRE(column.runCount() == 4);
+    TEST_CHECK(column.runType(0) == anyTypeId<int>());
+    TEST_CHECK(column.runSize(0) == 100);
+    TEST_REQUIRE(column.runData<int>(0) != nullptr);
+    TEST_CHECK(column.runData<int>(0)[99] == 99);
+    TEST_CHECK(column.runData<double>(0) == nullptr);
+
+    TEST_CHECK(column[47].cast<int>() == 47);
+    TEST_CHECK(column[100].cast<std::string>() == "string");
+    TEST_CHECK(column[101].cast<double>() == 1.5);
+    TEST_CHECK(column[102].cast<int>() == 100);
+
+    long sum = 0;
+    column.forEach<int>([&](int v) { sum += v; });
+    TEST_CHECK(sum == 4950 + 100);
+    column.clear();
+    TEST_CHECK(column.empty() && column.runCount() == 0);
+}
+
+TEST_CASE(shared_any_test)
+{
+    SharedAny a = std::string(100, 'a');
+    SharedAny b = a;
+    const SharedAny c = a;
+    TEST_CHECK(a.useCount() == 3);
+    TEST_CHECK(&b.value() == &a.value());                   /**< 拷贝只增加引用计数 */
+    TEST_CHECK(c.cast<std::string>().size() == 100);
+    TEST_CHECK(a.useCount() == 3);                          /**< 只读访问不拷贝 */
+
+    b.cast<std::string>()[0] = 'b';                         /**< 写时拷贝 */
+    TEST_CHECK(b.useCount() == 1);
+    TEST_CHECK(a.useCount() == 2);
+    TEST_CHECK(c.cast<std::string>()[0] == 'a');
+    TEST_CHECK(b.cast<std::string>()[0] == 'b');
+    TEST_CHECK(b.useCount() == 1);
+
+    b = c;
+    TEST_CHECK(a.useCount() == 3);
+    SharedAny d = std::move(b);
+    TEST_CHECK(b.isNull() && b.useCount() == 0);
+    TEST_CHECK(d.try_cast<int>() == nullptr);
+    TEST_CHECK(a.useCount() == 3);
+    TEST_CHECK(SharedAny{}.is<void>());
+
+    /** AnyRef和visit看到的是SharedAny中储存的对象 */
+    SharedAny number = 47;
+    AnyRef ref = number;
+    TEST_CHECK(ref.is<int>() && ref.cast<int>() == 47);
+    TEST_CHECK(ref.data() == number.value().try_cast<int>());
+    TEST_CHECK((visit<int, std::string>(number, [](const auto& v) { return sizeof(v); }) == sizeof(int)));
+    TEST_CHECK(number.useCount() == 1);
+}
+
+struct NotComparable
+{
+};
+
+TEST_CASE(any_compare_hash_test)
+{
+    TEST_CHECK(Any{47} == Any{47});
+    TEST_CHECK(Any{47} != Any{48});
+    TEST_CHECK(Any{47} != Any{47L});                        /**< 类型不同 */
+    TEST_CHECK(Any{} == Any{});
+    TEST_CHECK(Any{47} < Any{48});
+    TEST_CHECK(!(Any{48} < Any{47}));
+    TEST_CHECK((Any{47} < Any{47L}) != (Any{47L} < Any{47}));
+    TEST_CHECK(AnyRef{std::string{"a"}} == Any{std::string{"a"}});
+    TEST_CHECK(SharedAny{std::string{"a"}} == SharedAny{std::string{"a"}});
+
+    std::unordered_map<Any, int> cache;
+    cache[47] = 1;
+    cache[std::string{"47"}] = 2;
+    cache[47L] = 3;
+    TEST_CHECK(cache.size() == 3);
+    TEST_CHECK(cache[47] == 1);
+    TEST_CHECK(cache[std::string{"47"}] == 2);
+    std::set<Any> ordered{3, 1, 2, 1};
+    TEST_CHECK(ordered.size() == 3);
+    TEST_CHECK(ordered.begin()->cast<int>() == 1);
+
+    TEST_CHECK(anyTypeId<NotComparable>()->equal == nullptr);
+    bool thrown = false;
+    try
+    {
+        std::hash<Any>{}(NotComparable{});
+    }
+    catch (std::logic_error&)
+    {
+        thrown = true;
+    }
+    TEST_CHECK(thrown);
+    /** 容器和pair声明了==与<, 但元素不支持时不实例化比较函数 */
+    using Callbacks = std::vector<std::function<void()>>;
+    using Tagged = std::pair<int, NotComparable>;
+    Any callbacks = Callbacks{};
+    Any tagged = Tagged{};
+    UniqueAny unique = Callbacks{};
+    TEST_CHECK(callbacks.is<Callbacks>() && tagged.is<Tagged>() && unique.is<Callbacks>());
+    TEST_CHECK(AnyRef{tagged}.is<Tagged>());
+    TEST_CHECK(anyTypeId<Callbacks>()->equal == nullptr && anyTypeId<Callbacks>()->less == nullptr);
+    TEST_CHECK(anyTypeId<Tagged>()->equal == nullptr && anyTypeId<Tagged>()->less == nullptr);
+    TEST_CHECK((anyTypeId<std::map<int, std::vector<NotComparable>>>()->equal == nullptr));
+    TEST_CHECK((anyTypeId<std::tuple<int, NotComparable>>()->less == nullptr));
+    TEST_CHECK(anyTypeId<std::vector<std::string>>()->equal != nullptr);
+    TEST_CHECK((anyTypeId<std::pair<int, std::string>>()->less != nullptr));
+    thrown = false;
+    try
+    {
+        callbacks == Any{Callbacks{}};
+    }
+    catch (std::logic_error&)
+    {
+        thrown = true;
+    }
+    TEST_CHECK(thrown);
+}
+
+TEST_CASE(any_visit_test)
+{
+    auto describe = overloaded(
+        [](int v) { return "int:" + std::to_string(v); },
+        [](const std::string& v) { return "string:" + v; },
+        [](double) { return std::string{"double"}; });
+    Any a = 47;
+    const Any b = std::string{"string"};
+    TEST_CHECK((visit<int, std::string, double>(a, describe) == "int:47"));
+    TEST_CHECK((visit<int, std::string, double>(b, describe) == "string:string"));
+    TEST_CHECK((visit<int, std::string, double>(AnyRef{1.5}, describe) == "double"));
+
+    visit<int, long>(a, [](auto& v) { v += 1; });         /**< 非const的Any可以修改 */
+    TEST_CHECK(a.cast<int>() == 48);
+
+    bool thrown = false;
+    try
+    {
+        visit<long, double>(a, [](auto) {});
+    }
+    catch (std::bad_cast&)
+    {
+        thrown = true;
+    }
+    TEST_CHECK(thrown);
+}
+
+struct Point
+{
+    int x;
+    int y;
+};
+
+/** AnySerializer<T>是否有定义 */
+template<typename T, typename = void>
+struct HasAnySerializer : std::false_type {};
+
+template<typename T>
+struct HasAnySerializer<T, decltype(void(sizeof(AnySerializer<T>)))> : std::true_type {};
+
+static_assert(HasAnySerializer<Point>::value, "trivially copyable types are serialized by default");
+static_assert(!HasAnySerializer<const char*>::value, "pointers are only valid inside one process");
+static_assert(!HasAnySerializer<int Point::*>::value, "member pointers are not serialized by default");
+
+TEST_CASE(any_registry_test)
+{
+    AnyRegistry registry;
+    registry.add<int>(1);
+    registry.add<double>(2);
+    registry.add<std::string>(3);
+    registry.add<Point>(4);
+
+    std::string buf;
+    registry.write(Any{47}, buf);
+    registry.write(std::string{"string"}, buf);
+    registry.write(Point{1, 2}, buf);
+    registry.write(1.5, buf);
+    TEST_CHECK(buf.size() % AnyRegistry::record_align == 0);
+
+    size_t offset = 0;
+    Any a = registry.read(buf.data(), buf.size(), offset);
+    TEST_CHECK(a.cast<int>() == 47);
+    AnyRef s = registry.view(buf.data(), buf.size(), offset);   /**< std::string不能原地引用 */
+    TEST_CHECK(s.isNull());
+    TEST_CHECK(registry.read(buf.data(), buf.size(), offset).cast<std::string>() == "string");
+    AnyRef p = registry.view(buf.data(), buf.size(), offset);
+    TEST_REQUIRE(p.is<Point>());
+    TEST_CHECK(p.cast<Point>().y == 2);
+    TEST_CHECK(static_cast<const char*>(p.data()) > buf.data());   /**< 直接引用缓冲区 */
+    TEST_CHECK(registry.view(buf.data(), buf.size(), offset).cast<double>() == 1.5);
+    TEST_CHECK(offset == buf.size());
+
+    bool thrown = false;
+    try
+    {
+        registry.read(buf.data(), 4, offset = 0);
+    }
+    catch (std::runtime_error&)
+    {
+        thrown = true;
+    }
+    TEST_CHECK(thrown);
+}
+
+TEST_CASE(any_map_test)
+{
+    AnyMap map;
+    TEST_CHECK(map.find("missing") == nullptr);
+    map["retry"] = 3;
+    map["user"] = std::string{"lucklove"};
+    const std::string long_key(100, 'k');
+    map[long_key] = 1.5;
+    TEST_CHECK(map.size() == 3);
+    TEST_REQUIRE(map.find("retry") != nullptr);
+    map.find("retry")->cast<int>() += 1;
+    TEST_CHECK(map["retry"].cast<int>() == 4);
+    TEST_CHECK(map.find(long_key)->cast<double>() == 1.5);
+    TEST_CHECK(map.size() == 3);
+
+    for (int i = 0; i < 1000; ++i)                          /**< 多次扩容 */
+        map["key" + std::to_string(i)] = i;
+    TEST_CHECK(map.size() == 1003);
+    for (int i = 0; i < 1000; i += 2)
+        TEST_CHECK(map.erase("key" + std::to_string(i)));
+    TEST_CHECK(!map.erase("key0"));
+    TEST_CHECK(map.size() == 503);
+    bool all_found = true;
+    for (int i = 1; i < 1000; i += 2)
+    {
+        const Any* value = map.find("key" + std::to_string(i));
+        all_found = all_found && value != nullptr && value->cast<int>() == i;
+    }
+    TEST_CHECK(all_found);
+
+    const AnyMap copy = map;
+    size_t count = 0;
+    copy.forEach([&](const char*, size_t, const Any&) { ++count; });
+    TEST_CHECK(count == 503);
+    TEST_CHECK(copy.find("user")->cast<std::string>() == "lucklove");
+    map.clear();
+    TEST_CHECK(map.empty() && map.find("user") == nullptr);
+    TEST_CHECK(copy.size() == 503);
+
+    /** 条目不多的表只分配几个槽位, reserve之后插入不再扩容 */
+    AnyMap small;
+    small["a"] = 1;
+    TEST_CHECK(small.capacity() == AnyMap::initial_capacity);
+    AnyMap reserved;
+    reserved.reserve(32);
+    const size_t capacity = reserved.capacity();
+    for (int i = 0; i < 32; ++i)
+        reserved["key" + std::to_string(i)] = i;
+    TEST_CHECK(reserved.size() == 32 && reserved.capacity() == capacity);
+    reserved.reserve(4);
+    TEST_CHECK(reserved.capacity() == capacity);
+}
+
+struct CountedCopy
+{
+    CountedCopy() = default;
+    CountedCopy(const CountedCopy&) { ++copies; }
+    static size_t copies;
+};
+
+size_t CountedCopy::copies = 0;
+
+TEST_CASE(any_trivial_copy_test)
+{
+    struct Pod
+    {
+        int a;
+        double b;
+    };
+    Any a = Pod{1, 2.5};
+    Any b = a;
+    Any c = std::move(b);
+    TEST_CHECK(b.isNull());
+    TEST_CHECK(c.cast<Pod>().a == 1 && c.cast<Pod>().b == 2.5);
+    TEST_CHECK(AnyRef{c}.cast<Pod>().b == 2.5);
+    TEST_CHECK(&AnyRef{c}.cast<Pod>() == &c.cast<Pod>());
+    c = Any{};
+    TEST_CHECK(c.isNull() && c.is<void>());
+
+    Any d = CountedCopy{};                                  /**< 非平凡拷贝仍然调用拷贝构造 */
+    CountedCopy::copies = 0;
+    Any e = d;
+    TEST_CHECK(CountedCopy::copies == 1);
+}
+
+TEST_CASE(atomic_any_test)
+{
+    AtomicAny config{Any{std::string{"v0"}}};
+    {
+        AtomicAny::Snapshot snapshot = config.read();
+        TEST_CHECK(snapshot->cast<std::string>() == "v0");
+    }
+    config.store(std::string{"v1"});
+    TEST_CHECK(config.load().cast<std::string>() == "v1");
+
+    /** 读者总是看到某个完整的版本 */
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> torn{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t)
+    {
+        readers.emplace_back([&]
+        {
+            while (!stop.load())
+            {
+                AtomicAny::Snapshot snapshot = config.read();
+                const std::string& value = snapshot->cast<std::string>();
+                if (value.size() != 100 && value != "v1")
+                    ++torn;
+                else if (value.size() == 100 && value.find_first_not_of(value[0]) != std::string::npos)
+                    ++torn;
+            }
+        });
+    }
+    for (int i = 0; i < 1000; ++i)
+        config.store(std::string(100, char('a' + i % 26)));
+    stop = true;
+    for (std::thread& reader : readers)
+        reader.join();
+    TEST_CHECK(torn == 0);
+}
@@ -0,0 +1,81 @@
+#include "UnitTest.hh"
+#include "Any.hh"
+#include <string>
+
+/**
+ * 定义了ZBASE_DIAGNOSTIC_HOOK, ZBASE_ANY_ACCOUNTING和ZBASE_NO_RTTI时的测试, 编译为单独的zbase_hook_test,
+ * 因为所有编译单元必须一致地定义或不定义这些宏.
+ */
+
+static size_t any_diagnostic_count = 0;
+static std::string any_diagnostic_expected;
+
+TEST_CASE(any_type_name_test)
+{
+    TEST_CHECK(std::string{anyTypeName<int>()} == "int");
+    TEST_CHECK(std::string{anyTypeName<const char*>()} == "const char*");
+    TEST_CHECK(std::string{anyTypeName<Any>()} == "Any");
+    TEST_CHECK(anyTypeName<int>() == anyTypeName<int>());    /**< 每个类型只生成一次 */
+}
+
+TEST_CASE(any_diagnostic_hook_test)
+{
+    Any a = 47;
+    zbaseDiagnosticHook().store([](const char*, const char* expected, const char*)
+    {
+        ++any_diagnostic_count;
+        any_diagnostic_expected = expected;
+    });
+    try
+    {
+        a.cast<long>();
+    }
+    catch (std::bad_cast&)
+    {
+    }
+    zbaseDiagnosticHook().store(nullptr);
+    TEST_CHECK(any_diagnostic_count == 1);
+    TEST_CHECK(any_diagnostic_expected == "long int");
+
+    /** 未设置钩子时丢弃诊断信息 */
+    try
+    {
+        a.cast<long>();
+    }
+    catch (std::bad_cast&)
+    {
+    }
+    TEST_CHECK(any_diagnostic_count == 1);
+}
+
+struct Accounted
+{
+    char data[100];
+};
+
+static AnyHeapStat any_heap_stat(AnyTypeId type)
+{
+    for (const AnyHeapStat& stat : anyHeapSnapshot())
+    {
+        if (stat.type == type)
+            return stat;
+    }
+    return AnyHeapStat{type, nullptr, 0, 0};
+}
+
+TEST_CASE(any_accounting_test)
+{
+    {
+        Any a = Accounted{};
+        Any b = a;
+        Any small = 47;                                     /**< 内联储存不计入 */
+        AnyHeapStat stat = any_heap_stat(anyTypeId<Accounted>());
+        TEST_CHECK(stat.live == 2);
+        TEST_CHECK(stat.bytes >= 2 * sizeof(Accounted));
+        TEST_CHECK(stat.name != nullptr);
+        TEST_CHECK(any_heap_stat(anyTypeId<int>()).live == 0);
+    }
+    AnyHeapStat stat = any_heap_stat(anyTypeId<Accounted>());
+    TEST_CHECK(stat.live == 0);
+    TEST_CHECK(stat.bytes == 0);
+}
@@ -0,0 +1,51 @@
+#include "UnitTest.hh"
+#include "Any.hh"
+#include "Variant.hh"
+#include <string>
+
+struct alignas(8) InteropNode
+{
+    int value;
+};
+
+/** 两个头文件同时包含时, Any和Variant的visit互不干扰 */
+TEST_CASE(any_variant_visit_test)
+{
+    InteropNode node{40};
+    PackedVariant<InteropNode*, int32_t> packed = &node;
+    auto packedVisitor = overloaded([](InteropNode* n) { return n->value; }, [](int32_t v) { return v; });
+    TEST_CHECK(visit(packedVisitor, packed) == 40);
+
+    Variant<int, std::string> variant = 5;
+    auto variantVisitor = overloaded([](int v) { return v; }, [](const std::string& s) { return int(s.size()); });
+    TEST_CHECK(visit(variantVisitor, variant) == 5);
+
+    Any any = 2;
+    TEST_CHECK((visit<int, std::string>(any, variantVisitor) == 2));
+    AnyRef ref = any;
+    TEST_CHECK((visit<int, std::string>(ref, variantVisitor) == 2));
+    const Any text = std::string{"text"};
+    TEST_CHECK((visit<int, std::string>(text, variantVisitor) == 4));
+}
+
+struct ArenaList;
+using ArenaValue = Variant<int, VariantBox<ArenaList>>;
+
+struct ArenaList
+{
+    ArenaValue head;
+    Any payload;
+};
+
+/** Any的大对象和VariantBox共用同一个内存池 */
+TEST_CASE(any_variant_arena_test)
+{
+    ZBaseArena arena;
+    {
+        AnyResourceScope scope(arena);
+        ArenaValue list = VariantBox<ArenaList>{ArenaList{ArenaValue{1}, Any{std::string(100, 'a')}}};
+        TEST_CHECK(&anyCurrentResource() == &zbaseCurrentResource());
+        TEST_CHECK(list.get<VariantBox<ArenaList>>()->payload.cast<std::string>().size() == 100);
+    }
+    arena.release();
+}
@@ -1,5 +1,6 @@
 #include "UnitTest.hh"
 #include "Optional.hh"
+#include <string>
 
 Optional<int> func(bool f)
 {
@@ -19,3 +20,21 @@ TEST_CASE(optional_test)
     TEST_CHECK(!func(false)); 
     TEST_CHECK(*func(true) == 47);
 }
+
+static_assert(std::is_trivially_copyable<Optional<int>>::value, "Optional<int> must be trivially copyable");
+static_assert(!std::is_trivially_copyable<Optional<std::string>>::value, "Optional<std::string> must copy its value");
+
+TEST_CASE(optional_copy_test)
+{
+    Optional<std::string> s = std::string{"string"};
+    Optional<std::string> copy = s;
+    TEST_CHECK(*copy == "string");
+    Optional<std::string> moved = std::move(s);
+    TEST_CHECK(*moved == "string" && !s);
+    copy = Optional<std::string>{};
+    TEST_CHECK(!copy);
+
+    Optional<int> i = 47;
+    Optional<int> j = i;
+    TEST_CHECK(*j == 47);
+}
@@ -1,6 +1,10 @@
 #include "UnitTest.hh"
 #include "Variant.hh"
 #include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <stdexcept>
 
 TEST_CASE(varaint_test)
 {
@@ -15,3 +19,488 @@ TEST_CASE(varaint_test)
     TEST_REQUIRE(v.is<const char*>());
     TEST_CHECK(v.get<const char*>() == std::string{"const char*"});
 }
+
+TEST_CASE(variant_get_if_test)
+{
+    Variant<int, std::string> v = std::string{"string"};
+    TEST_CHECK(v.get_if<int>() == nullptr);
+    TEST_REQUIRE(v.get_if<std::string>() != nullptr);
+    TEST_CHECK(*v.get_if<std::string>() == "string");
+    const Variant<int, std::string>& cv = v;
+    TEST_CHECK(cv.get_if<std::string>() == v.get_if<std::string>());
+    bool thrown = false;
+    try
+    {
+        v.get<int>();
+    }
+    catch (std::bad_cast&)
+    {
+        thrown = true;
+    }
+    TEST_CHECK(thrown);
+}
+
+TEST_CASE(variant_index_test)
+{
+    using V = Variant<int, std::string, double>;
+    TEST_CHECK(sizeof(Variant<int, float>) == 2 * sizeof(int));    /**< 下标只占一个字节 */
+    V v;
+    TEST_CHECK(v.Empty() && v.is<void>() && v.index() == -1);
+    TEST_CHECK(v.type() == std::type_index(typeid(void)));
+    v = std::string{"string"};
+    TEST_CHECK(v.index() == 1);
+    TEST_CHECK(v.type() == std::type_index(typeid(std::string)));
+    const V copy = v;
+    V moved = std::move(v);
+    TEST_REQUIRE(copy.get_if<std::string>() != nullptr);
+    TEST_CHECK(*copy.get_if<std::string>() == "string");
+    TEST_CHECK(moved.get<std::string>() == "string");
+}
+
+TEST_CASE(variant_visit_test)
+{
+    Variant<int, std::string, double> v = std::string{"string"};
+    auto visitor = overloaded(
+        [](int i) { return std::to_string(i); },
+        [](const std::string& s) { return s; },
+        [](double) { return std::string{"double"}; });
+    TEST_CHECK(visit(visitor, v) == "string");
+    v = 47;
+    TEST_CHECK(visit(visitor, v) == "47");
+    const Variant<int, std::string, double> cv = 1.5;
+    TEST_CHECK(visit(visitor, cv) == "double");
+
+    /** 按引用访问, 可以修改储存的对象 */
+    visit([](auto& value) { value = value + value; }, v);
+    TEST_CHECK(v.get<int>() == 94);
+
+    /** 多个Variant按类型组合分派 */
+    Variant<int, std::string> a = 1, b = std::string{"b"};
+    auto pair = overloaded(
+        [](int, int) { return 0; },
+        [](int, const std::string&) { return 1; },
+        [](const std::string&, int) { return 2; },
+        [](const std::string&, const std::string&) { return 3; });
+    TEST_CHECK(visit(pair, a, a) == 0);
+    TEST_CHECK(visit(pair, a, b) == 1);
+    TEST_CHECK(visit(pair, b, a) == 2);
+    TEST_CHECK(visit(pair, b, b) == 3);
+    auto sum = overloaded(
+        [](int i) { return i; },
+        [](const std::string& s) { return int(s.size()); });
+    TEST_CHECK(visit([&](const auto& x, const auto& y, const auto& z) { return sum(x) + sum(y) + sum(z); },
+        a, b, Variant<int, std::string>{2}) == 4);
+
+    /** 超过64种组合时经过函数指针表 */
+    using Wide = Variant<char, short, int, long long, float, double, bool, unsigned char, unsigned short>;
+    Wide w1 = short{1}, w2 = 2.0;
+    TEST_CHECK(visit([](auto x, auto y) { return sizeof(x) + sizeof(y); }, w1, w2) == sizeof(short) + sizeof(double));
+
+    Variant<int, std::string> empty;
+    bool thrown = false;
+    try
+    {
+        visit(pair, a, empty);
+    }
+    catch (std::bad_cast&)
+    {
+        thrown = true;
+    }
+    TEST_CHECK(thrown);
+}
+
+/** 统计存活的对象数量和赋值次数 */
+struct Tracked
+{
+    static int live;
+    static int assigns;
+    Tracked() { ++live; }
+    Tracked(const Tracked&) { ++live; }
+    Tracked(Tracked&&) { ++live; }
+    Tracked& operator=(const Tracked&) { ++assigns; return *this; }
+    Tracked& operator=(Tracked&&) { ++assigns; return *this; }
+    ~Tracked() { --live; }
+};
+int Tracked::live = 0;
+int Tracked::assigns = 0;
+
+TEST_CASE(variant_assign_test)
+{
+    using V = Variant<int, Tracked, std::string>;
+    {
+        V v = Tracked{};
+        V other = Tracked{};
+        TEST_CHECK(Tracked::live == 2);
+        v = other;                          /**< 候选类型相同, 使用Tracked自身的赋值 */
+        v = std::move(other);
+        v = Tracked{};
+        TEST_CHECK(Tracked::assigns == 3);
+        TEST_CHECK(Tracked::live == 2);
+        v = 47;                             /**< 候选类型改变, 先销毁原来的对象 */
+        TEST_CHECK(Tracked::live == 1);
+        other = v;
+        TEST_CHECK(Tracked::live == 0);
+        TEST_CHECK(other.get<int>() == 47);
+        v = Tracked{};
+        v = v;
+        TEST_CHECK(Tracked::live == 1);
+    }
+    TEST_CHECK(Tracked::live == 0);
+
+    /** 相同候选类型的std::string复用已有的容量, 不重新分配 */
+    V s = std::string(100, 'a');
+    const char* buffer = s.get<std::string>().data();
+    const std::string text(50, 'b');
+    s = text;
+    TEST_CHECK(s.get<std::string>().data() == buffer);
+    const V shorter = std::string(80, 'c');
+    s = shorter;
+    TEST_CHECK(s.get<std::string>().data() == buffer);
+    TEST_CHECK(s.get<std::string>() == std::string(80, 'c'));
+}
+
+static_assert(std::is_trivially_copyable<Variant<int, float>>::value, "Variant of trivial types must be trivially copyable");
+static_assert(std::is_trivially_destructible<Variant<int, double, const char*>>::value, "Variant of trivial types must be trivially destructible");
+static_assert(!std::is_trivially_copyable<Variant<int, std::string>>::value, "Variant of std::string must copy through the table");
+
+TEST_CASE(variant_trivial_test)
+{
+    std::vector<Variant<int, float>> values;
+    for (int i = 0; i < 100; ++i)
+        values.push_back(i % 2 ? Variant<int, float>{i} : Variant<int, float>{float(i)});
+    values.resize(1000);    /**< 扩容时整体memcpy */
+    TEST_CHECK(values[99].get<int>() == 99);
+    TEST_CHECK(values[98].get<float>() == 98.0f);
+    TEST_CHECK(values[999].Empty());
+    Variant<int, float> copy = values[99];
+    copy = values[98];
+    TEST_CHECK(copy.is<float>());
+}
+
+/** 拷贝时按标记抛出异常 */
+struct ThrowOnCopy
+{
+    explicit ThrowOnCopy(bool t) : fail(t) {}
+    ThrowOnCopy(const ThrowOnCopy& that) : fail(that.fail)
+    {
+        if (fail)
+            throw std::runtime_error{"copy failed"};
+    }
+    ThrowOnCopy(ThrowOnCopy&&) = default;
+    bool fail;
+};
+
+TEST_CASE(variant_vector_test)
+{
+    VariantVector<int, double, std::string> values;
+    for (int i = 0; i < 10; ++i)
+    {
+        values.push_back(i);
+        values.push_back(i * 0.5);
+    }
+    values.push_back(std::string{"string"});
+    values.push_back(Variant<int, double, std::string>{std::string{"variant"}});
+    TEST_CHECK(values.size() == 22);
+    TEST_CHECK(values.count<int>() == 10 && values.count<double>() == 10 && values.count<std::string>() == 2);
+    TEST_CHECK(values.index(3) == 1);
+    TEST_REQUIRE(values.get_if<double>(3) != nullptr);
+    TEST_CHECK(*values.get_if<double>(3) == 0.5);
+    TEST_CHECK(values.get_if<int>(3) == nullptr);
+    TEST_CHECK(values.at(21).get<std::string>() == "variant");
+    TEST_CHECK(values.visit(4, [](const auto& v) { return sizeof(v); }) == sizeof(int));
+
+    /** 按类型分组访问 */
+    int ints = 0;
+    double doubles = 0;
+    std::string strings;
+    values.visit_all(overloaded(
+        [&](int& i) { ints += i; },
+        [&](double& d) { doubles += d; },
+        [&](std::string& s) { strings += s; }));
+    TEST_CHECK(ints == 45);
+    TEST_CHECK(doubles == 22.5);
+    TEST_CHECK(strings == "stringvariant");
+
+    /** 按最大的候选类型(std::string)补齐的布局更大 */
+    TEST_CHECK(values.bytes() < values.variantBytes());
+    values.clear();
+    TEST_CHECK(values.empty() && values.count<int>() == 0 && values.bytes() == 0);
+
+    /** 构造失败时各数组保持一致 */
+    VariantVector<int, ThrowOnCopy> guarded;
+    guarded.push_back(1);
+    const ThrowOnCopy bad{true};
+    bool thrown = false;
+    try
+    {
+        guarded.push_back(bad);
+    }
+    catch (std::runtime_error&)
+    {
+        thrown = true;
+    }
+    TEST_CHECK(thrown);
+    TEST_CHECK(guarded.size() == 1 && guarded.count<ThrowOnCopy>() == 0);
+    guarded.push_back(ThrowOnCopy{false});
+    guarded.push_back(2);
+    TEST_CHECK(guarded.size() == 3 && guarded.index(1) == 1);
+    TEST_REQUIRE(guarded.get_if<int>(2) != nullptr);
+    TEST_CHECK(*guarded.get_if<int>(2) == 2);
+}
+
+struct alignas(8) PackedNode
+{
+    int value;
+};
+
+/** 用户声明的空闲位: 16位的句柄存放在高位 */
+struct Handle
+{
+    uint16_t id;
+};
+
+template<>
+struct VariantNiche<Handle>
+{
+    static constexpr unsigned spare_bits = 16;
+    static uintptr_t encode(Handle h) { return uintptr_t(h.id) << 16; }
+    static Handle decode(uintptr_t word) { return Handle{uint16_t(word >> 16)}; }
+};
+
+TEST_CASE(packed_variant_test)
+{
+    using P = PackedVariant<PackedNode*, double*, int32_t>;
+    TEST_CHECK(sizeof(P) == sizeof(void*));
+    static_assert(std::is_trivially_copyable<P>::value, "PackedVariant must be trivially copyable");
+
+    P empty;
+    TEST_CHECK(empty.Empty() && empty.index() == -1);
+
+    PackedNode node{47};
+    P p = &node;
+    TEST_CHECK(p.is<PackedNode*>() && p.index() == 0);
+    TEST_CHECK(p.get<PackedNode*>()->value == 47);
+    p = int32_t(-5);
+    TEST_CHECK(p.is<int32_t>() && p.get<int32_t>() == -5);
+    p = static_cast<PackedNode*>(nullptr);
+    TEST_CHECK(!p.Empty() && p.get<PackedNode*>() == nullptr);
+    TEST_CHECK(p == P{static_cast<PackedNode*>(nullptr)} && p != empty);
+
+    bool thrown = false;
+    try
+    {
+        p.get<int32_t>();
+    }
+    catch (std::bad_cast&)
+    {
+        thrown = true;
+    }
+    TEST_CHECK(thrown);
+
+    PackedVariant<Handle, PackedNode*> h = Handle{7};
+    auto id = overloaded(
+        [](Handle handle) { return int(handle.id); },
+        [](PackedNode* n) { return n->value; });
+    TEST_CHECK(visit(id, h) == 7);
+    h = &node;
+    TEST_CHECK(visit(id, h) == 47);
+
+    PackedVariant<PackedNode*, bool> flag = true;
+    TEST_CHECK(flag.is<bool>() && flag.get<bool>());
+    flag = false;
+    TEST_CHECK(flag.is<bool>() && !flag.get<bool>());
+    flag = &node;
+    TEST_CHECK(flag.get<PackedNode*>() == &node);
+}
+
+/** 统计拷贝和移动的次数 */
+struct MoveCounted
+{
+    static int copies;
+    static int moves;
+    MoveCounted(int a, int b) : value(a + b) {}
+    MoveCounted(const MoveCounted& that) : value(that.value) { ++copies; }
+    MoveCounted(MoveCounted&& that) : value(that.value) { ++moves; }
+    int value;
+};
+int MoveCounted::copies = 0;
+int MoveCounted::moves = 0;
+
+TEST_CASE(variant_emplace_test)
+{
+    using V = Variant<int, MoveCounted, std::string>;
+    V a(inPlaceType<MoveCounted>, 40, 7);
+    TEST_CHECK(a.get<MoveCounted>().value == 47);
+    V b(inPlaceIndex<2>, 3, 'x');
+    TEST_CHECK(b.get<std::string>() == "xxx");
+    MoveCounted& m = b.emplace<MoveCounted>(1, 2);
+    TEST_CHECK(&m == b.get_if<MoveCounted>() && m.value == 3);
+    TEST_CHECK(b.emplace<0>(47) == 47 && b.is<int>());
+    TEST_CHECK(MoveCounted::copies == 0 && MoveCounted::moves == 0);
+
+    /** 对照: 从临时对象构造会移动一次 */
+    V c = MoveCounted{1, 1};
+    TEST_CHECK(c.get<MoveCounted>().value == 2);
+    TEST_CHECK(MoveCounted::copies == 0 && MoveCounted::moves == 1);
+}
+
+TEST_CASE(variant_compare_hash_test)
+{
+    using V = Variant<int, std::string>;
+    TEST_CHECK(V{1} == V{1});
+    TEST_CHECK(V{1} != V{2});
+    TEST_CHECK(V{1} != V{std::string{"1"}});
+    TEST_CHECK(V{} == V{} && V{} != V{0});
+
+    /** 先按下标, 再按值 */
+    TEST_CHECK(V{1} < V{2} && !(V{2} < V{1}) && !(V{1} < V{1}));
+    TEST_CHECK(V{100} < V{std::string{"a"}});
+    TEST_CHECK(V{std::string{"a"}} < V{std::string{"b"}});
+    TEST_CHECK(V{} < V{0} && !(V{} < V{}));
+
+    std::set<V> sorted = { V{std::string{"b"}}, V{2}, V{std::string{"a"}}, V{1}, V{2} };
+    TEST_CHECK(sorted.size() == 4);
+    TEST_CHECK(*sorted.begin() == V{1});
+    TEST_CHECK(*sorted.rbegin() == V{std::string{"b"}});
+
+    std::unordered_map<V, int> index;
+    index[V{47}] = 1;
+    index[V{std::string{"47"}}] = 2;
+    TEST_CHECK(index.size() == 2);
+    TEST_CHECK(index[V{47}] == 1 && index[V{std::string{"47"}}] == 2);
+    TEST_CHECK(std::hash<V>{}(V{47}) == std::hash<V>{}(V{47}));
+}
+
+/** 递归的表达式树 */
+struct Binary;
+using Expr = Variant<int, VariantBox<Binary>>;
+
+struct Binary
+{
+    char op;
+    Expr lhs;
+    Expr rhs;
+    bool operator==(const Binary& that) const { return op == that.op && lhs == that.lhs && rhs == that.rhs; }
+    bool operator<(const Binary& that) const
+    {
+        if (op != that.op)
+            return op < that.op;
+        return lhs == that.lhs ? rhs < that.rhs : lhs < that.lhs;
+    }
+};
+
+namespace std
+{
+    template<>
+    struct hash<Binary>
+    {
+        size_t operator()(const Binary& b) const
+        {
+            return size_t(b.op) ^ (b.lhs.hash() * 31) ^ (b.rhs.hash() * 131);
+        }
+    };
+}
+
+int evaluate(const Expr& expr)
+{
+    return visit(overloaded(
+        [](int v) { return v; },
+        [](const VariantBox<Binary>& b) { return b->op == '+' ? evaluate(b->lhs) + evaluate(b->rhs) : evaluate(b->lhs) * evaluate(b->rhs); }), expr);
+}
+
+/** 统计分配次数, 转发给operator new/delete */
+struct CountingVariantResource : ZBaseMemoryResource
+{
+    int allocations = 0;
+    int deallocations = 0;
+    void* allocate(size_t size, size_t align) override
+    {
+        ++allocations;
+        return ZBaseNewDeleteResource::instance().allocate(size, align);
+    }
+    void deallocate(void* p, size_t size, size_t align) noexcept override
+    {
+        ++deallocations;
+        ZBaseNewDeleteResource::instance().deallocate(p, size, align);
+    }
+};
+
+TEST_CASE(variant_box_test)
+{
+    static_assert(sizeof(VariantBox<Binary>) == sizeof(void*), "VariantBox must be a single pointer");
+    CountingVariantResource counting;
+    {
+        ZBaseResourceScope scope(counting);
+        /** (1 + 2) * 4 */
+        Expr sum = VariantBox<Binary>{Binary{'+', Expr{1}, Expr{2}}};
+        Expr product = VariantBox<Binary>{Binary{'*', std::move(sum), Expr{4}}};
+        TEST_CHECK(evaluate(product) == 12);
+        TEST_CHECK(counting.allocations == 2);      /**< 每个节点分配一次, 移动不分配 */
+
+        Expr copy = product;                        /**< 深拷贝两个节点 */
+        TEST_CHECK(counting.allocations == 4);
+        TEST_CHECK(copy == product);
+        copy.get<VariantBox<Binary>>()->rhs = 5;
+        TEST_CHECK(evaluate(copy) == 15 && evaluate(product) == 12);
+        TEST_CHECK(!(copy == product));
+
+        /** sum的盒子已被移走: 空盒子之间相等, 小于非空的盒子, 哈希值为0 */
+        const VariantBox<Binary>& moved = sum.get<VariantBox<Binary>>();
+        const VariantBox<Binary>& full = product.get<VariantBox<Binary>>();
+        TEST_CHECK(moved.empty() && moved == moved);
+        TEST_CHECK(!(moved == full) && !(full == moved));
+        TEST_CHECK(moved < full && !(full < moved) && !(moved < moved));
+        TEST_CHECK(std::hash<VariantBox<Binary>>{}(moved) == 0);
+        TEST_CHECK(sum == sum && sum != product && sum < product);
+    }
+    TEST_CHECK(counting.allocations == counting.deallocations);
+
+    /** 把盒子替换为它的子节点的盒子 */
+    {
+        ZBaseResourceScope scope(counting);
+        Expr tree = VariantBox<Binary>{Binary{'+', VariantBox<Binary>{Binary{'*', Expr{2}, Expr{3}}}, Expr{4}}};
+        VariantBox<Binary>& root = tree.get<VariantBox<Binary>>();
+        root = std::move(root->lhs.get<VariantBox<Binary>>());
+        TEST_CHECK(evaluate(tree) == 6);
+        tree = VariantBox<Binary>{Binary{'+', VariantBox<Binary>{Binary{'*', Expr{5}, Expr{3}}}, Expr{4}}};
+        tree = std::move(tree.get<VariantBox<Binary>>()->lhs);
+        TEST_CHECK(evaluate(tree) == 15);
+    }
+    TEST_CHECK(counting.allocations == counting.deallocations);
+
+    /** 从内存池分配的1000个节点只向上游申请一次大块内存 */
+    CountingVariantResource upstream;
+    ZBaseArena arena(64 * 1024, upstream);
+    {
+        ZBaseResourceScope scope(arena);
+        Expr expr = 1;
+        for (int i = 0; i < 1000; ++i)
+            expr = VariantBox<Binary>{Binary{'+', std::move(expr), Expr{1}}};
+        TEST_CHECK(evaluate(expr) == 1001);
+        TEST_CHECK(upstream.allocations == 1);
+    }
+    arena.release();
+    TEST_CHECK(upstream.allocations == 1 && upstream.deallocations == 1);
+}
+
+TEST_CASE(variant_subtree_assign_test)
+{
+    /** 赋值的来源位于当前值之中: 把节点替换为它的子节点 */
+    Expr copied = VariantBox<Binary>{Binary{'+', Expr{1}, Expr{2}}};
+    copied = copied.get<VariantBox<Binary>>()->lhs;
+    TEST_CHECK(copied.is<int>() && copied.get<int>() == 1);
+
+    Expr moved = VariantBox<Binary>{Binary{'+', Expr{1}, Expr{2}}};
+    moved = std::move(moved.get<VariantBox<Binary>>()->rhs);
+    TEST_CHECK(moved.is<int>() && moved.get<int>() == 2);
+
+    Expr value = VariantBox<Binary>{Binary{'+', Expr{3}, Expr{4}}};
+    value = value.get<VariantBox<Binary>>()->lhs.get<int>();
+    TEST_CHECK(value.is<int>() && value.get<int>() == 3);
+
+    using Text = Variant<int, std::string>;
+    Text text = std::string(64, 'x');
+    text = Text{47};
+    text = std::string(64, 'y');
+    TEST_CHECK(text.is<std::string>() && text.get<std::string>() == std::string(64, 'y'));
+}